@@ -0,0 +1,90 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if STUDENT_SOLUTION || COURSE_SOLUTION
+#include "../external/json.hpp"
+#else
+#include "external/json.hpp"
+#endif
+
+class Geometry;
+class Instance;
+class Light;
+class Output;
+struct GeometryGroup;
+
+// The "sequence" section of a scene file, without it the scene is a single frame.
+struct SequenceSettings
+{
+    unsigned int frames = 0; // 0 when the scene is not a sequence
+    unsigned int start = 0; // First frame rendered, to pick a sequence up where it stopped
+    double rebuild_ratio = 1.5; // A refit BVH is built again once its nodes cover this many times their area after the build
+
+    inline bool IsSequence() const { return frames > 0; }
+};
+
+// Keyframes of one property, a number or an array of numbers. The values are linearly interpolated between the keys
+// and held before the first key and after the last.
+struct Track
+{
+    std::string property;
+    bool scalar = false;
+    std::vector<double> frames; // In increasing order
+    std::vector<std::vector<double>> values; // One per frame
+
+    nlohmann::json Evaluate(double frame) const
+    {
+        size_t next = std::upper_bound(frames.begin(), frames.end(), frame) - frames.begin();
+
+        const std::vector<double>& after = values[std::min(next, values.size() - 1)];
+        const std::vector<double>& before = values[next > 0 ? next - 1 : 0];
+
+        double t = 0.0;
+        if (next > 0 && next < frames.size()) t = (frame - frames[next - 1]) / (frames[next] - frames[next - 1]);
+
+        if (scalar) return before[0] + t * (after[0] - before[0]);
+
+        nlohmann::json value = nlohmann::json::array();
+        for (size_t i = 0; i < before.size(); i++) value.push_back(before[i] + t * (after[i] - before[i]));
+
+        return value;
+    }
+};
+
+enum class AnimatedType : uint8_t { Sphere, Rectangle, Instance, PointLight, AreaLight, Output };
+
+// A scene element that changes over the frames. Every frame its tracks are written over a copy of its scene file entry,
+// which is read again into the element where it already is, so a frame allocates no scene memory.
+struct AnimatedElement
+{
+    AnimatedType type = AnimatedType::Sphere;
+    nlohmann::json base;
+    std::vector<Track> tracks;
+
+    // The one of these that matches the type is set.
+    Geometry* geometry = nullptr;
+    GeometryGroup* group = nullptr; // Of the geometry, its BVH is refit after it moved
+    Instance* instance = nullptr;
+    Light* light = nullptr;
+    Output* output = nullptr;
+};
+
+// "name.ppm" becomes "name_0042.ppm" for frame 42.
+inline std::string FrameFileName(const std::string& file_name, unsigned int frame)
+{
+    char number[16];
+    std::snprintf(number, sizeof(number), "_%04u", frame);
+
+    size_t dot = file_name.find_last_of('.');
+    if (dot == std::string::npos) return file_name + number;
+
+    return file_name.substr(0, dot) + number + file_name.substr(dot);
+}
+
+#endif // !ANIMATION_H
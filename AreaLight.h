@@ -17,8 +17,8 @@ class AreaLight : public Light
 
 public:
     AreaLight() = delete;
-    AreaLight(std::string type, Color id, Color is, Eigen::Vector3d& p1, Eigen::Vector3d& p2, Eigen::Vector3d& p3, Eigen::Vector3d& p4, bool use_center, unsigned int n)
-        : Light(type, id, is), rectangle(p1,p2,p3,p4), use_center(use_center)
+    AreaLight(std::string type, const Color& id, const Color& is, Eigen::Vector3d& p1, Eigen::Vector3d& p2, Eigen::Vector3d& p3, Eigen::Vector3d& p4, bool use_center, unsigned int n)
+        : Light(type, id, is), rectangle(p1,p2,p3,p4), use_center(use_center), sample_count(n)
     {
         if (use_center)
         {
@@ -33,26 +33,6 @@ public:
 
             center = a * x + p3;
         }
-        else // Use the full light
-        {
-            double lerp1 = 0.0f;
-            while (lerp1 < 1.0f)
-            {
-                lerp1 = YuMath::Clamp(lerp1 + (1.0f / n), 0.0f, 1.0f);
-
-                Vector3d l1 = YuMath::Lerp(p3, p4, lerp1);
-                Vector3d l2 = YuMath::Lerp(p2, p1, lerp1);
-
-                double lerp2 = 0.0f;
-
-                while (lerp2 < 1.0f)
-                {
-                    hits_points.push_back(YuMath::Lerp(l1, l2, lerp2));
-
-                    lerp2 = YuMath::Clamp(lerp2 + (1.0f / n), 0.0f, 1.0f);
-                }
-            }
-        }
     }
 
     ~AreaLight()
@@ -67,8 +47,15 @@ public:
     inline auto& GetRectangle() { return rectangle; }
     inline bool GetUseCenter() const { return use_center; }
     inline auto& GetCenter() const { return center; }
-    inline auto& GetHitPoints() { return hits_points; }
+    inline unsigned int GetSampleCount() const { return sample_count; } // Samples per side, n * n in total
+    inline double GetArea() const { return rectangle.GetArea(); }
+    inline const auto& GetNormal() const { return rectangle.GetNormal(); }
 
+    // Point on the light at the (u, v) coordinates, both going from 0 to 1.
+    Vector3d GetPoint(double u, double v) const
+    {
+        return GetP1() + u * (GetP2() - GetP1()) + v * (GetP4() - GetP1());
+    }
 
 
     friend std::ostream& operator << (std::ostream& os, const AreaLight& al)
@@ -84,7 +71,7 @@ private:
     Rectangle rectangle;
     bool use_center = false;
     Vector3d center;
-    std::vector<Vector3d> hits_points;
+    unsigned int sample_count = 4;
 };
 
 #endif
@@ -0,0 +1,77 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Contiguous storage for the objects of one type. Objects are constructed in place and live until Clear,
+// which destroys them all and keeps the memory so the next scene of the same size allocates nothing.
+// Pointers to the objects stay valid until then, the arena never moves them.
+template <typename T>
+class Arena
+{
+public:
+    Arena() {}
+    ~Arena() { Release(); }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Makes room for capacity objects, only grows while the arena is empty.
+    // Returns false when objects already live in the arena and they don't fit.
+    bool Reserve(size_t capacity)
+    {
+        if (capacity <= this->capacity) return true;
+        if (count != 0) return false;
+
+        Release();
+
+        storage = static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t(alignof(T))));
+        this->capacity = capacity;
+
+        return true;
+    }
+
+    // Returns nullptr once the reserved capacity is used up.
+    template <typename... Args>
+    T* Create(Args&&... args)
+    {
+        if (count == capacity) return nullptr;
+
+        T* object = new (storage + count) T(std::forward<Args>(args)...);
+        count++;
+
+        return object;
+    }
+
+    void Clear()
+    {
+        while (count > 0) storage[--count].~T();
+    }
+
+    size_t Size() const { return count; }
+    size_t Capacity() const { return capacity; }
+
+    T* begin() { return storage; }
+    T* end() { return storage + count; }
+    const T* begin() const { return storage; }
+    const T* end() const { return storage + count; }
+
+private:
+    void Release()
+    {
+        Clear();
+
+        if (storage != nullptr) ::operator delete(storage, std::align_val_t(alignof(T)));
+
+        storage = nullptr;
+        capacity = 0;
+    }
+
+    T* storage = nullptr;
+    size_t count = 0;
+    size_t capacity = 0;
+};
+
+#endif // !ARENA_H
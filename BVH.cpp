@@ -0,0 +1,104 @@
+#include "BVH.h"
+
+#include <numeric>
+
+void BVH::Build(const std::vector<Bounds>& item_bounds)
+{
+    Clear();
+
+    if (item_bounds.empty()) return;
+
+    items.resize(item_bounds.size());
+    std::iota(items.begin(), items.end(), 0u);
+
+    std::vector<Eigen::Vector3d> centres;
+    centres.reserve(item_bounds.size());
+    for (const Bounds& bounds : item_bounds) centres.push_back(bounds.Centre());
+
+    nodes.reserve(2 * (item_bounds.size() / LEAF_SIZE + 1));
+
+    BuildNode(item_bounds, centres, 0, (uint32_t)items.size());
+
+    build_area = NodeArea();
+}
+
+void BVH::Refit(const std::vector<Bounds>& item_bounds)
+{
+    // Children come after their parent, going backwards every child is done before its parent.
+    for (size_t index = nodes.size(); index-- > 0;)
+    {
+        Node& node = nodes[index];
+        Bounds bounds;
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = 0; i < node.count; i++) bounds.Grow(item_bounds[items[node.offset + i]]);
+        }
+        else
+        {
+            bounds.Grow(nodes[index + 1].bounds);
+            bounds.Grow(nodes[node.offset].bounds);
+        }
+
+        node.bounds = bounds;
+    }
+}
+
+void BVH::Clear()
+{
+    nodes.clear();
+    items.clear();
+    build_area = 0.0;
+}
+
+double BVH::NodeArea() const
+{
+    if (nodes.empty()) return 0.0;
+
+    double root = nodes[0].bounds.SurfaceArea();
+    if (root <= 0.0) return 0.0;
+
+    double sum = 0.0;
+    for (const Node& node : nodes) sum += node.bounds.SurfaceArea();
+
+    return sum / root;
+}
+
+uint32_t BVH::BuildNode(const std::vector<Bounds>& item_bounds, const std::vector<Eigen::Vector3d>& centres, uint32_t begin, uint32_t end)
+{
+    uint32_t index = (uint32_t)nodes.size();
+    nodes.emplace_back();
+
+    Bounds bounds, centre_bounds;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        bounds.Grow(item_bounds[items[i]]);
+        centre_bounds.Grow(centres[items[i]]);
+    }
+
+    nodes[index].bounds = bounds;
+
+    if (end - begin <= LEAF_SIZE)
+    {
+        nodes[index].offset = begin;
+        nodes[index].count = end - begin;
+
+        return index;
+    }
+
+    int axis;
+    (centre_bounds.max - centre_bounds.min).maxCoeff(&axis);
+
+    uint32_t middle = begin + (end - begin) / 2;
+    std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return centres[a][axis] < centres[b][axis]; });
+
+    // The left child is built right after this node, only the right one needs its index kept.
+    BuildNode(item_bounds, centres, begin, middle);
+    uint32_t right = BuildNode(item_bounds, centres, middle, end);
+
+    nodes[index].axis = (uint8_t)axis;
+    nodes[index].offset = right;
+
+    return index;
+}
@@ -0,0 +1,152 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "EigenIncludes.h"
+#include "Statistics.h"
+
+// Axis aligned box, empty until something is added to it.
+struct Bounds
+{
+    Eigen::Vector3d min = Eigen::Vector3d::Constant(DBL_MAX);
+    Eigen::Vector3d max = Eigen::Vector3d::Constant(-DBL_MAX);
+
+    void Grow(const Eigen::Vector3d& point)
+    {
+        min = min.cwiseMin(point);
+        max = max.cwiseMax(point);
+    }
+
+    void Grow(const Bounds& other)
+    {
+        min = min.cwiseMin(other.min);
+        max = max.cwiseMax(other.max);
+    }
+
+    // Flat primitives give boxes without thickness, the margin keeps rounding from missing them.
+    void Pad(double margin)
+    {
+        min -= Eigen::Vector3d::Constant(margin);
+        max += Eigen::Vector3d::Constant(margin);
+    }
+
+    bool Empty() const { return min.x() > max.x(); }
+    Eigen::Vector3d Centre() const { return 0.5 * (min + max); }
+
+    double SurfaceArea() const
+    {
+        if (Empty()) return 0.0;
+
+        Eigen::Vector3d size = max - min;
+        return 2.0 * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+    }
+
+    // Slab test, true when the ray passes through the box between its origin and max_t.
+    bool Intersect(const Eigen::Vector3d& origin, const Eigen::Vector3d& inverse_direction, double max_t) const
+    {
+        Eigen::Vector3d t0 = (min - origin).cwiseProduct(inverse_direction);
+        Eigen::Vector3d t1 = (max - origin).cwiseProduct(inverse_direction);
+
+        double t_enter = std::max(0.0, t0.cwiseMin(t1).maxCoeff());
+        double t_exit = std::min(max_t, t0.cwiseMax(t1).minCoeff());
+
+        return t_enter <= t_exit;
+    }
+};
+
+// Bounding volume hierarchy over a list of boxes, the items are known by their index in that list.
+// The nodes are stored depth first, the left child of an inner node is the node right after it.
+class BVH
+{
+public:
+    static const uint32_t LEAF_SIZE = 4;
+
+    struct Node
+    {
+        Bounds bounds;
+        uint32_t offset = 0; // First item of a leaf, right child of an inner node
+        uint32_t count = 0; // Items of a leaf, 0 for an inner node
+        uint8_t axis = 0; // Split axis of an inner node
+    };
+
+    // Splits at the median of the box centres along their widest axis.
+    void Build(const std::vector<Bounds>& item_bounds);
+    // Grows the boxes of the nodes around the items where they are now, the tree itself is kept. item_bounds has
+    // to list the items the BVH was built with, in the same order.
+    void Refit(const std::vector<Bounds>& item_bounds);
+    void Clear();
+
+    // Surface area of the nodes against what it was after the build, a refit tree gets slower to walk as it grows.
+    // Exactly 1 after a build.
+    double Degradation() const { return build_area > 0.0 ? NodeArea() / build_area : 1.0; }
+
+    inline bool Empty() const { return nodes.empty(); }
+    inline size_t NodeCount() const { return nodes.size(); }
+    // Box around every item, empty without items.
+    inline Bounds GetBounds() const { return nodes.empty() ? Bounds() : nodes[0].bounds; }
+
+    // Calls on_item(index) for every item whose box the ray crosses before max_t, the ray being origin + t * direction.
+    // on_item may lower max_t to cull the rest, and returns true to stop the walk.
+    template <typename OnItem>
+    void Traverse(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double& max_t, OnItem on_item) const
+    {
+        if (nodes.empty()) return;
+
+        // A tiny component instead of 0 keeps 0 * infinity out of the slab test.
+        Eigen::Vector3d inverse_direction;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            inverse_direction[axis] = 1.0 / (std::abs(direction[axis]) > 1e-300 ? direction[axis] : std::copysign(1e-300, direction[axis]));
+        }
+
+        uint32_t stack[64];
+        int size = 0;
+        stack[size++] = 0;
+
+        while (size > 0)
+        {
+            uint32_t index = stack[--size];
+            const Node& node = nodes[index];
+
+            STAT_COUNT(BVHNodesVisited);
+            if (!node.bounds.Intersect(origin, inverse_direction, max_t)) continue;
+
+            if (node.count > 0)
+            {
+                for (uint32_t i = 0; i < node.count; i++)
+                {
+                    if (on_item(items[node.offset + i])) return;
+                }
+                continue;
+            }
+
+            // The near child is popped first, its hits shorten max_t for the far one.
+            if (direction[node.axis] > 0.0)
+            {
+                stack[size++] = node.offset;
+                stack[size++] = index + 1;
+            }
+            else
+            {
+                stack[size++] = index + 1;
+                stack[size++] = node.offset;
+            }
+        }
+    }
+
+private:
+    uint32_t BuildNode(const std::vector<Bounds>& item_bounds, const std::vector<Eigen::Vector3d>& centres, uint32_t begin, uint32_t end);
+    // Sum of the node areas over the area of the root, what a ray crossing the root pays on average in node tests.
+    double NodeArea() const;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> items; // Item indices in leaf order
+    double build_area = 0.0;
+};
+
+#endif // !BVH_H
@@ -11,43 +11,43 @@ Camera& Camera::GetInstance()
 	return instance;
 }
 
-void Camera::SetData(const Output& output, float resolution_factor = 1.0f)
+void Camera::SetData(const Output& output, float resolution_factor, bool keep_image)
 {
 	fov = output.fov;
 	look_at = output.look_at;
 	up = output.up;
 	position = output.center;
 	right = up.cross(look_at);
-	height = (uint16_t)(output.GetHeight() * resolution_factor);
-	width = (uint16_t)(output.GetWidth() * resolution_factor);
+	height = (uint32_t)(output.GetHeight() * resolution_factor);
+	width = (uint32_t)(output.GetWidth() * resolution_factor);
 	aspect_ratio = (double)width / (double)height;
 	origin_lookat = position + look_at;
 
 	half_image = std::tan(Deg2Rad * fov * 0.5f);
 	pixel_center = half_image / height;
 
-	if (output.GetC() != nullptr)
+	if (output.GetRaysPerPixelCount() >= 3)
 	{
-		grid_height = *output.GetA();
-		grid_width = *output.GetB(); 
-		sample_size = *output.GetC();
+		grid_height = output.GetA();
+		grid_width = output.GetB(); 
+		sample_size = output.GetC();
 	}
 	else 
 	{
-		if (output.GetB() != nullptr)
+		if (output.GetRaysPerPixelCount() == 2)
 		{
 			// Square
-			grid_height = *output.GetA();
-			grid_width = *output.GetA();
-			sample_size = *output.GetB();
+			grid_height = output.GetA();
+			grid_width = output.GetA();
+			sample_size = output.GetB();
 		}
-		else if (output.GetA() != nullptr)
+		else if (output.GetRaysPerPixelCount() == 1)
 		{
 
 			grid_height = 1;
 			grid_width = 1;
 
-			sample_size = *output.GetA();
+			sample_size = output.GetA();
 		}
 		else
 		{
@@ -63,8 +63,18 @@ void Camera::SetData(const Output& output, float resolution_factor = 1.0f)
 	max_bounce = output.GetMaxBounce();
 	probe_terminate = output.GetProbeTerminate();
 
-	delete ppm_buffer;
-	ppm_buffer = new std::vector<Color>((size_t)width * (size_t)height);
+	// Kept between outputs and frames, an image of the same size reuses the memory of the last one.
+	if (ppm_buffer == nullptr) ppm_buffer = new std::vector<Color>();
+
+	if (keep_image) ppm_buffer->assign((size_t)width * (size_t)height, Color());
+	else std::vector<Color>().swap(*ppm_buffer);
+
+	// The denoiser needs the albedo, normal and depth whether they are saved or not.
+	unsigned int aovs = output.GetAOVs() | (output.Denoise() ? AOV_ALBEDO | AOV_NORMAL | AOV_DEPTH : 0u);
+	if (!keep_image) aovs = 0;
+
+	if (aovs != 0) features.Resize((size_t)width * (size_t)height, aovs);
+	else features.Clear();
 }
 
 Camera::~Camera()
@@ -78,10 +88,11 @@ Ray Camera::MakeRay(Vector3d& destination) const
 }
 
 std::vector<Color>& Camera::GetOutputBuffer() { return *ppm_buffer; }
+FeatureBuffers& Camera::GetFeatureBuffers() { return features; }
 
 
-uint16_t Camera::Height() const { return height; }
-uint16_t Camera::Width() const { return width; }
+uint32_t Camera::Height() const { return height; }
+uint32_t Camera::Width() const { return width; }
 double Camera::AspectRatio() const { return aspect_ratio; }
 double Camera::FOV() const { return fov; }
 Vector3d Camera::Position() const { return position; }
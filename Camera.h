@@ -5,6 +5,7 @@
 #include "Ray.h"
 #include "EigenIncludes.h"
 #include "YuMath.h"
+#include "FeatureBuffers.h"
 
 using namespace Eigen;
 
@@ -16,7 +17,8 @@ public:
 
 	static Camera& GetInstance();
 
-	void SetData(const Output& output, float resolution_factor);
+	// Without keep_image the image and feature buffers are not allocated, the tracer streams the tiles to a file instead.
+	void SetData(const Output& output, float resolution_factor, bool keep_image = true);
 
 	Camera(const Camera& other) = delete;
 
@@ -27,9 +29,10 @@ public:
 	Ray MakeRay(Vector3d& destination) const;
 
 	std::vector<Color>& GetOutputBuffer();
+	FeatureBuffers& GetFeatureBuffers(); // Empty unless the output is denoised
 
-	uint16_t Height() const;
-	uint16_t Width() const;					
+	uint32_t Height() const;
+	uint32_t Width() const;					
 	double AspectRatio() const;			
 	double FOV() const;					
 	Vector3d Position() const;
@@ -55,8 +58,8 @@ private:
 	static Camera* instance;
 
 	double fov{};
-	uint16_t height{};
-	uint16_t width{};
+	uint32_t height{};
+	uint32_t width{};
 	double aspect_ratio{};
 	double pixel_center{};
 	double half_image{};
@@ -77,6 +80,7 @@ private:
 	double probe_terminate{};
 
 	std::vector<Color>* ppm_buffer = nullptr;
+	FeatureBuffers features;
 };
 
 
@@ -3,11 +3,78 @@
 
 #include "EigenIncludes.h"
 
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define COLOR_SSE 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define COLOR_NEON 1
+#include <arm_neon.h>
+#endif
+
 using namespace Eigen;
 
-struct Color
+// The four lanes of a color register, r, g, b and a padding lane kept at 0.
+namespace ColorSimd
+{
+#if COLOR_SSE
+    typedef __m128 Vec;
+
+    inline Vec Load(const float* p) { return _mm_load_ps(p); }
+    inline void Store(float* p, Vec v) { _mm_store_ps(p, v); }
+    inline Vec Set(float r, float g, float b, float a) { return _mm_setr_ps(r, g, b, a); }
+    inline Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+    inline Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+    inline Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+    inline Vec Div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+    inline Vec Min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+    inline Vec Max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+#if defined(__FMA__) || defined(__AVX2__)
+    inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm_fmadd_ps(a, b, c); }
+#else
+    inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#endif
+#elif COLOR_NEON
+    typedef float32x4_t Vec;
+
+    inline Vec Load(const float* p) { return vld1q_f32(p); }
+    inline void Store(float* p, Vec v) { vst1q_f32(p, v); }
+    inline Vec Set(float r, float g, float b, float a) { const float lanes[4] = { r, g, b, a }; return vld1q_f32(lanes); }
+    inline Vec Add(Vec a, Vec b) { return vaddq_f32(a, b); }
+    inline Vec Sub(Vec a, Vec b) { return vsubq_f32(a, b); }
+    inline Vec Mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+    inline Vec Div(Vec a, Vec b) { return vdivq_f32(a, b); }
+    inline Vec Min(Vec a, Vec b) { return vminq_f32(a, b); }
+    inline Vec Max(Vec a, Vec b) { return vmaxq_f32(a, b); }
+    inline Vec MulAdd(Vec a, Vec b, Vec c) { return vfmaq_f32(c, a, b); }
+#else
+    struct Vec { float v[4]; };
+
+    template <typename Op>
+    inline Vec Lanes(Vec a, Vec b, Op op) { Vec out; for (int i = 0; i < 4; i++) out.v[i] = op(a.v[i], b.v[i]); return out; }
+
+    inline Vec Load(const float* p) { Vec out; for (int i = 0; i < 4; i++) out.v[i] = p[i]; return out; }
+    inline void Store(float* p, Vec v) { for (int i = 0; i < 4; i++) p[i] = v.v[i]; }
+    inline Vec Set(float r, float g, float b, float a) { return Vec{ { r, g, b, a } }; }
+    inline Vec Add(Vec a, Vec b) { return Lanes(a, b, [](float x, float y) { return x + y; }); }
+    inline Vec Sub(Vec a, Vec b) { return Lanes(a, b, [](float x, float y) { return x - y; }); }
+    inline Vec Mul(Vec a, Vec b) { return Lanes(a, b, [](float x, float y) { return x * y; }); }
+    inline Vec Div(Vec a, Vec b) { return Lanes(a, b, [](float x, float y) { return x / y; }); }
+    inline Vec Min(Vec a, Vec b) { return Lanes(a, b, [](float x, float y) { return x < y ? x : y; }); }
+    inline Vec Max(Vec a, Vec b) { return Lanes(a, b, [](float x, float y) { return x > y ? x : y; }); }
+    inline Vec MulAdd(Vec a, Vec b, Vec c) { return Add(Mul(a, b), c); }
+#endif
+
+    inline Vec Splat(float v) { return Set(v, v, v, 0.0f); }
+    inline Vec Divisor(float v) { return Set(v, v, v, 1.0f); } // Keeps the padding lane at 0 through a division
+}
+
+// Sits in one 16 byte SIMD register, the operators work on the three channels at once.
+struct alignas(16) Color
 {
     float r, g, b;
+    float a = 0.0f; // Padding lane of the register, always 0
 
     ///Default this->b lack
     Color() : r(0.0f), g(0.0f), b(0.0f) {}
@@ -42,91 +109,117 @@ struct Color
     static Color White() { return Color(1, 1, 1); }
     static Color Magenta() { return Color(1, 0, 1); }
 
-    Color Clamp()
+    // a * b + c in one pass, fused when the CPU has FMA.
+    static Color MulAdd(const Color& a, const Color& b, const Color& c)
+    {
+        return Color(ColorSimd::MulAdd(a.Load(), b.Load(), c.Load()));
+    }
+
+    static Color MulAdd(const Color& a, double b, const Color& c)
+    {
+        return Color(ColorSimd::MulAdd(a.Load(), ColorSimd::Splat((float)b), c.Load()));
+    }
+
+    // this += a * b without the temporary.
+    Color& AddMul(const Color& a, const Color& b)
+    {
+        Store(ColorSimd::MulAdd(a.Load(), b.Load(), Load()));
+        return *this;
+    }
+
+    Color& AddMul(const Color& a, double b)
+    {
+        Store(ColorSimd::MulAdd(a.Load(), ColorSimd::Splat((float)b), Load()));
+        return *this;
+    }
+
+    // NaN channels become 0.
+    Color Clamp() const
+    {
+        return Color(ColorSimd::Min(ColorSimd::Max(Load(), ColorSimd::Splat(0.0f)), ColorSimd::Splat(1.0f)));
+    }
+
+    float Average() const
     {
-        float r = this->r < 0.0f ? 0.0f : this->r > 1.0f ? 1.0f : this->r;
-        float g = this->g < 0.0f ? 0.0f : this->g > 1.0f ? 1.0f : this->g;
-        float b = this->b < 0.0f ? 0.0f : this->b > 1.0f ? 1.0f : this->b;
+        return (r + g + b) / 3.0f;
+    }
 
-        return Color{r,g,b};
+    bool IsFinite() const
+    {
+        return std::isfinite(r) && std::isfinite(g) && std::isfinite(b);
     }
 
     Color(const Color& other)
     {
-        this->r = other.r;
-        this->g = other.g;
-        this->b = other.b;
+        Store(other.Load());
     }
 
     Color& operator=(const Color& other)
     {
-        this->r = other.r;
-        this->g = other.g;
-        this->b = other.b;
+        Store(other.Load());
         return *this;
     }
-    
-    bool operator== (const Color& other)
+
+    bool operator== (const Color& other) const
     {
-        return 
+        return
             (this->r  == other.r) &&
             (this->g  == other.g) &&
             (this->b  == other.b);
     }
-    
+
     Color& operator*= (const Color& other)
     {
-        this->r *= other.r;
-        this->g *= other.g;
-        this->b *= other.b;
+        Store(ColorSimd::Mul(Load(), other.Load()));
         return *this;
     }
 
     // Handamard product
     Color operator* (const Color& other) const
     {
-        return Color(this->r * other.r, this->g * other.g, this->b * other.b);
+        return Color(ColorSimd::Mul(Load(), other.Load()));
     }
 
     Color operator* (const Vector3d& other) const
     {
-        return Color(this->r * (float)other.x(), this->g * (float)other.y(), this->b * (float)other.z());
+        return Color(ColorSimd::Mul(Load(), ColorSimd::Set((float)other.x(), (float)other.y(), (float)other.z(), 0.0f)));
     }
 
     Color operator*(double val) const
     {
-        return Color(this->r * (float)val, this->g * (float)val, this->b * (float)val);
+        return Color(ColorSimd::Mul(Load(), ColorSimd::Splat((float)val)));
     }
 
     Color operator/(double val) const
     {
-        return Color(this->r  / (float)val, this->g / (float)val, this->b / (float)val);
+        return Color(ColorSimd::Div(Load(), ColorSimd::Divisor((float)val)));
     }
 
     Color operator/(Eigen::Vector3d val) const
     {
-        return Color(this->r / (float)val.x(), this->g / (float)val.y(), this->b / (float)val.z());
+        return Color(ColorSimd::Div(Load(), ColorSimd::Set((float)val.x(), (float)val.y(), (float)val.z(), 1.0f)));
     }
 
     Color& operator/=(double val)
     {
-        this->r /= (float)val;
-        this->g /= (float)val;
-        this->b /= (float)val;
+        Store(ColorSimd::Div(Load(), ColorSimd::Divisor((float)val)));
         return *this;
     }
 
-    Color operator+(const Color& other)
+    Color operator+(const Color& other) const
+    {
+        return Color(ColorSimd::Add(Load(), other.Load()));
+    }
+
+    Color operator-(const Color& other) const
     {
-        return Color(this->r + other.r, this->g + other.g, this->b + other.b);
+        return Color(ColorSimd::Sub(Load(), other.Load()));
     }
 
     Color& operator+=(const Color& other)
     {
-        this->r += other.r;
-        this->g += other.g;
-        this->b += other.b;
-        return *this; 
+        Store(ColorSimd::Add(Load(), other.Load()));
+        return *this;
     }
 
     std::string ToString() const
@@ -139,6 +232,12 @@ struct Color
         os << "Color (" << color.r << ", " << color.g << ", " << color.b << ")";
         return os;
     }
+
+private:
+    explicit Color(ColorSimd::Vec v) { Store(v); }
+
+    ColorSimd::Vec Load() const { return ColorSimd::Load(&r); }
+    void Store(ColorSimd::Vec v) { ColorSimd::Store(&r, v); }
 };
 
-#endif
\ No newline at end of file
+#endif
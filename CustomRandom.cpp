@@ -2,11 +2,20 @@
 #include "YuMath.h"
 
 #include <random>
+#include <atomic>
 #include <ctime>
 
+// Every thread draws from its own engine, rand() shares one state between all of them.
+static std::mt19937& Engine()
+{
+	static std::atomic<unsigned int> stream{ 0 };
+	thread_local std::mt19937 engine((unsigned int)std::time(nullptr) + 7919u * stream++); // seeds the RNG
+
+	return engine;
+}
+
 CustomRandom::CustomRandom()
 {
-	std::srand((unsigned int)std::time(nullptr)); // seeds the RNG
 }
 
 CustomRandom& CustomRandom::GetInstance()
@@ -18,18 +27,18 @@ CustomRandom& CustomRandom::GetInstance()
 
 double CustomRandom::Generate()
 {
-	return (float)rand() / (float)RAND_MAX;
+	return std::uniform_real_distribution<double>(0.0, 1.0)(Engine());
 }
 
 double CustomRandom::Generate(double num)
 {
-	return ((float)rand() / (float)RAND_MAX) * num * 2.0f - num;
+	return Generate() * num * 2.0f - num;
 }
 
 // Returns: angle in radian
 double CustomRandom::GenerateAngle(double angle)
 {
 	// Goes from 0 to angle.
-	return ((float)rand() / (float)RAND_MAX) * angle * Deg2Rad;
+	return Generate() * angle * Deg2Rad;
 }
 
@@ -0,0 +1,34 @@
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include <cstdint>
+#include <chrono>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CYCLE_COUNTER_TSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define CYCLE_COUNTER_TSC 1
+#else
+#define CYCLE_COUNTER_TSC 0
+#endif
+
+// Reads the time stamp counter. It ticks at a fixed reference rate, not at the current core clock,
+// so cycles measured with it drift from core cycles when the CPU boosts or throttles.
+namespace CycleCounter
+{
+	// False when there is no time stamp counter, Read then falls back to nanoseconds.
+	inline bool Available() { return CYCLE_COUNTER_TSC == 1; }
+
+	inline uint64_t Read()
+	{
+#if CYCLE_COUNTER_TSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+}
+
+#endif // !CYCLE_COUNTER_H
@@ -0,0 +1,110 @@
+#include "Denoiser.h"
+#include "Parallel.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace Denoiser
+{
+	static const float KERNEL[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+	static const float MIN_ALBEDO = 1e-3f;
+
+	static float Demodulate(float color, float albedo)
+	{
+		return albedo > MIN_ALBEDO ? color / albedo : color;
+	}
+
+	static float Remodulate(float irradiance, float albedo)
+	{
+		return albedo > MIN_ALBEDO ? irradiance * albedo : irradiance;
+	}
+
+	static float SquaredDistance(const Color& a, const Color& b)
+	{
+		float r = a.r - b.r, g = a.g - b.g, b_ = a.b - b.b;
+		return r * r + g * g + b_ * b_;
+	}
+
+	void ATrous(std::vector<Color>& image, const FeatureBuffers& features, uint32_t width, uint32_t height, const Settings& settings)
+	{
+		const size_t size = (size_t)width * height;
+
+		std::vector<Color> current(size), filtered(size);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			const Color& albedo = features.albedo[i];
+			current[i] = Color(Demodulate(image[i].r, albedo.r), Demodulate(image[i].g, albedo.g), Demodulate(image[i].b, albedo.b));
+		}
+
+		for (unsigned int iteration = 0; iteration < settings.iterations; iteration++)
+		{
+			const int step = 1 << iteration;
+			const double color_phi = settings.color_phi / (double)(1 << iteration);
+			const double color_phi_sqr = color_phi * color_phi;
+			const double albedo_phi_sqr = settings.albedo_phi * settings.albedo_phi;
+
+			// Rows only read current and write their own part of filtered.
+			Parallel::For(height, [&](size_t y)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					const size_t p = y * width + x;
+
+					const Color& color_p = current[p];
+					const Color& albedo_p = features.albedo[p];
+					const Eigen::Vector3d& normal_p = features.normal[p];
+					const double depth_p = features.depth[p];
+
+					double sum_r = 0.0, sum_g = 0.0, sum_b = 0.0, sum_weight = 0.0;
+
+					for (int dy = -2; dy <= 2; dy++)
+					{
+						int qy = (int)y + dy * step;
+						if (qy < 0 || qy >= (int)height) continue;
+
+						for (int dx = -2; dx <= 2; dx++)
+						{
+							int qx = (int)x + dx * step;
+							if (qx < 0 || qx >= (int)width) continue;
+
+							const size_t q = (size_t)qy * width + qx;
+							const double depth_q = features.depth[q];
+
+							double weight = KERNEL[dx + 2] * KERNEL[dy + 2];
+
+							// Background only blends with background.
+							if ((depth_p < 0.0) != (depth_q < 0.0)) continue;
+
+							if (depth_p >= 0.0)
+							{
+								weight *= std::exp(-std::abs(depth_p - depth_q) / (settings.depth_phi * depth_p * step + 1e-6));
+								weight *= std::pow(std::max(0.0, normal_p.dot(features.normal[q])), settings.normal_phi);
+							}
+
+							weight *= std::exp(-SquaredDistance(color_p, current[q]) / color_phi_sqr);
+							weight *= std::exp(-SquaredDistance(albedo_p, features.albedo[q]) / albedo_phi_sqr);
+
+							sum_r += weight * current[q].r;
+							sum_g += weight * current[q].g;
+							sum_b += weight * current[q].b;
+							sum_weight += weight;
+						}
+					}
+
+					// The center tap always has a weight, sum_weight is never 0.
+					filtered[p] = Color((float)(sum_r / sum_weight), (float)(sum_g / sum_weight), (float)(sum_b / sum_weight));
+				}
+			});
+
+			std::swap(current, filtered);
+		}
+
+		for (size_t i = 0; i < size; i++)
+		{
+			const Color& albedo = features.albedo[i];
+			image[i] = Color(Remodulate(current[i].r, albedo.r), Remodulate(current[i].g, albedo.g), Remodulate(current[i].b, albedo.b));
+		}
+	}
+}
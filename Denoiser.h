@@ -0,0 +1,24 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include <vector>
+
+#include "Color.h"
+#include "FeatureBuffers.h"
+
+namespace Denoiser
+{
+	struct Settings
+	{
+		unsigned int iterations = 5;
+		double color_phi = 0.6; // Halved every iteration
+		double normal_phi = 64.0; // Exponent of the normals' cosine
+		double depth_phi = 0.05; // Relative to the pixel's depth
+		double albedo_phi = 0.1;
+	};
+
+	// Edge avoiding a-trous wavelet filter (Dammertz et al.), runs on the albedo demodulated image so textures stay sharp.
+	void ATrous(std::vector<Color>& image, const FeatureBuffers& features, uint32_t width, uint32_t height, const Settings& settings);
+}
+
+#endif // !DENOISER_H
@@ -0,0 +1,131 @@
+#ifndef FEATURE_BUFFERS_H
+#define FEATURE_BUFFERS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "EigenIncludes.h"
+#include "Color.h"
+
+// Arbitrary output variables, one bit each so an output can ask for several.
+enum AOV : unsigned int
+{
+    AOV_ALBEDO = 1 << 0,
+    AOV_NORMAL = 1 << 1,
+    AOV_DEPTH = 1 << 2,
+    AOV_PRIMITIVE_ID = 1 << 3,
+    AOV_DIRECT = 1 << 4,
+    AOV_INDIRECT = 1 << 5,
+    AOV_SAMPLES = 1 << 6,
+    AOV_COST = 1 << 7,
+
+    AOV_LAST = AOV_COST
+};
+
+// Name used in the scene file and in the side-car file name, empty for an unknown AOV.
+inline std::string AOVName(unsigned int aov)
+{
+    switch (aov)
+    {
+    case AOV_ALBEDO: return "albedo";
+    case AOV_NORMAL: return "normal";
+    case AOV_DEPTH: return "depth";
+    case AOV_PRIMITIVE_ID: return "primid";
+    case AOV_DIRECT: return "direct";
+    case AOV_INDIRECT: return "indirect";
+    case AOV_SAMPLES: return "samples";
+    case AOV_COST: return "cost";
+    default: return "";
+    }
+}
+
+// Returns 0 when the name is not an AOV.
+inline unsigned int AOVFromName(const std::string& name)
+{
+    for (unsigned int aov = AOV_ALBEDO; aov <= AOV_LAST; aov <<= 1)
+    {
+        if (AOVName(aov).compare(name) == 0) return aov;
+    }
+
+    return 0;
+}
+
+// Per pixel data of the first hit, guides the denoiser and is saved as AOVs.
+// Only the buffers in the mask are allocated.
+struct FeatureBuffers
+{
+    std::vector<Color> albedo;
+    std::vector<Eigen::Vector3d> normal;
+    std::vector<double> depth; // Negative when the pixel sees the background
+    std::vector<int> primitive_id; // Negative when the pixel sees the background
+    std::vector<unsigned int> instance_id; // Of the primitive, allocated with it
+    std::vector<Color> direct;
+    std::vector<Color> indirect;
+    std::vector<unsigned int> samples; // Valid samples that made the pixel
+    std::vector<uint64_t> cost; // Time stamp counter cycles spent on the pixel, summed over the passes
+
+    unsigned int mask = 0;
+
+    void Resize(size_t size, unsigned int aovs)
+    {
+        Clear();
+
+        mask = aovs;
+
+        if (Has(AOV_ALBEDO)) albedo.assign(size, Color::Black());
+        if (Has(AOV_NORMAL)) normal.assign(size, Eigen::Vector3d::Zero());
+        if (Has(AOV_DEPTH)) depth.assign(size, -1.0);
+        if (Has(AOV_PRIMITIVE_ID))
+        {
+            primitive_id.assign(size, -1);
+            instance_id.assign(size, 0);
+        }
+        if (Has(AOV_DIRECT)) direct.assign(size, Color::Black());
+        if (Has(AOV_INDIRECT)) indirect.assign(size, Color::Black());
+        if (Has(AOV_SAMPLES)) samples.assign(size, 0);
+        if (Has(AOV_COST)) cost.assign(size, 0);
+    }
+
+    void Clear()
+    {
+        albedo.clear();
+        normal.clear();
+        depth.clear();
+        primitive_id.clear();
+        instance_id.clear();
+        direct.clear();
+        indirect.clear();
+        samples.clear();
+        cost.clear();
+
+        mask = 0;
+    }
+
+    bool Has(unsigned int aovs) const { return (mask & aovs) == aovs; }
+    bool Empty() const { return mask == 0; }
+
+    // Buffers that change from one progressive pass to the next. The normal, depth and primitive id of the first hit
+    // are the same every pass, the cost is already summed.
+    static const unsigned int PASS_AOVS = AOV_ALBEDO | AOV_DIRECT | AOV_INDIRECT | AOV_SAMPLES;
+
+    // Adds the pass just traced into sums, sized with Resize(size, mask & PASS_AOVS).
+    void AddPassTo(FeatureBuffers& sums) const
+    {
+        for (size_t i = 0; i < sums.albedo.size(); i++) sums.albedo[i] += albedo[i];
+        for (size_t i = 0; i < sums.direct.size(); i++) sums.direct[i] += direct[i];
+        for (size_t i = 0; i < sums.indirect.size(); i++) sums.indirect[i] += indirect[i];
+        for (size_t i = 0; i < sums.samples.size(); i++) sums.samples[i] += samples[i];
+    }
+
+    // Averages the colours over the passes like the image. The samples of all the passes made the pixel, they stay summed.
+    void SetPassAverage(const FeatureBuffers& sums, unsigned int passes)
+    {
+        for (size_t i = 0; i < sums.albedo.size(); i++) albedo[i] = sums.albedo[i] / (double)passes;
+        for (size_t i = 0; i < sums.direct.size(); i++) direct[i] = sums.direct[i] / (double)passes;
+        for (size_t i = 0; i < sums.indirect.size(); i++) indirect[i] = sums.indirect[i] / (double)passes;
+        for (size_t i = 0; i < sums.samples.size(); i++) samples[i] = sums.samples[i];
+    }
+};
+
+#endif // !FEATURE_BUFFERS_H
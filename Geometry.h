@@ -1,46 +1,36 @@
 #ifndef GEOMETRY_H
 #define GEOMETRY_H
 
+#include <cstdint>
 #include <string>
-#include "Color.h"
+#include <iostream>
 
-// Geometry and all its children are data containers
+// Type of a geometry, compared instead of a string in the hot loops.
+enum class GeometryType : uint8_t { Sphere, Rectangle };
+
+// Geometry and all its children are data containers, the shading data lives in the scene's material table.
 class Geometry
 {
 public:
     Geometry() {}
-    Geometry(std::string& type)
-        :type(type)
-    {
-    }
-    
-    Geometry(std::string& type, std::string& name,float& ka, float& kd, float& ks, float& pc, Color& ac, Color& dc, Color& sc)
-        : type(type), name(name), ka(ka), kd(kd), ks(ks), pc(pc), ac(ac), dc(dc), sc(sc)
+    Geometry(GeometryType type, uint16_t material)
+        : type(type), material(material)
     {
     }
 
     virtual ~Geometry() {}
 
-    inline const auto& GetType() const { return type; }
-    inline const auto& GetName() const { return name; }
-    inline const auto& GetPhongCoeff() const { return pc; }
-    inline const auto& GetAmbientColor() const { return ac; }
-    inline const auto& GetDiffuseColor() const { return dc; }
-    inline const auto& GetSpecularColor() const { return sc; }
-    inline const auto& GetSpecularCoeff() const { return ks; }
-    inline const auto& GetDiffuseCoeff() const { return kd; }
-    inline const auto& GetAmbientCoeff() const { return ka; }
+    inline GeometryType GetType() const { return type; }
+    inline uint16_t GetMaterial() const { return material; }
+
+    // Index of the geometry in the scene file, written in the primitive id AOV.
+    inline unsigned int GetId() const { return id; }
+    inline void SetId(unsigned int id) { this->id = id; }
 
     virtual std::string ToString() const
     {
-        return "\nType: " + GetType() +
-               "\nAmbient Coeff: " + std::to_string(ka) +
-               "\nDiffuse Coeff: " + std::to_string(kd) +
-               "\nSpecular Coeff: " + std::to_string(ks) +
-               "\nPhong Coeff: " + std::to_string(pc) +
-               "\nAmbient Color " + ac.ToString() +
-               "\nDiffuse Color " + dc.ToString() +
-               "\nSpecular Color " + sc.ToString() +'\n';
+        return "\nType: " + std::string(type == GeometryType::Sphere ? "sphere" : "rectangle") +
+               "\nMaterial: " + std::to_string(material) + '\n';
     }
 
     friend std::ostream& operator <<(std::ostream& os, const Geometry& geo)
@@ -50,16 +40,10 @@ public:
     }
 
 protected:
-    std::string type;
-    std::string name;
-    Color ac; // ambient color,
-    Color dc; // diffuse color, 
-    Color sc; // specular color
-    float ka = 0.0f; // ambient coeff
-    float kd = 0.0f; // Diffuse coeff
-    float ks = 0.0f; // Specular coeff
+    GeometryType type = GeometryType::Sphere;
+    uint16_t material = 0;
 
-    float pc = 0.0f; // phong coefficient
+    unsigned int id = 0;
 };
 
 #endif
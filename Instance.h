@@ -0,0 +1,81 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <string>
+#include <vector>
+
+#include "BVH.h"
+#include "Geometry.h"
+#include "Ray.h"
+
+// Geometry that is only placed in the scene through instances, it is stored once whatever the number of placements.
+// The loose geometry of the scene file is a group too, placed once without a transform.
+struct GeometryGroup
+{
+    std::string name;
+    std::vector<Geometry*> geometries;
+    BVH bvh; // Over the geometries, in the group's own space
+    bool moved = false; // A geometry changed since the BVH was last fitted
+};
+
+// A group placed in the scene with an affine transform, world = linear * local + translation.
+class Instance
+{
+public:
+    Instance(const GeometryGroup& group, const Eigen::Matrix3d& linear, const Eigen::Vector3d& translation)
+        : group(&group)
+    {
+        SetTransform(linear, translation);
+    }
+
+    // The bounds are left as they are until UpdateBounds.
+    void SetTransform(const Eigen::Matrix3d& linear, const Eigen::Vector3d& translation)
+    {
+        this->linear = linear;
+        this->translation = translation;
+
+        inverse_linear = linear.inverse();
+        normal_matrix = inverse_linear.transpose();
+        identity = linear.isIdentity() && translation.isZero();
+    }
+
+    inline const GeometryGroup& GetGroup() const { return *group; }
+    inline bool IsIdentity() const { return identity; }
+
+    // Same parameter t along both rays, the local direction is not normalized.
+    Ray ToLocal(const Ray& ray) const { return Ray(inverse_linear * (ray.GetOrigin() - translation), inverse_linear * ray.GetDirection()); }
+    Eigen::Vector3d PointToWorld(const Eigen::Vector3d& point) const { return linear * point + translation; }
+    Eigen::Vector3d NormalToWorld(const Eigen::Vector3d& normal) const { return (normal_matrix * normal).normalized(); }
+
+    // Box around the transformed box of the group, the group's BVH has to be built first.
+    void UpdateBounds()
+    {
+        Bounds local = group->bvh.GetBounds();
+        bounds = Bounds();
+
+        if (local.Empty()) return;
+
+        for (int corner = 0; corner < 8; corner++)
+        {
+            Eigen::Vector3d point((corner & 1) ? local.max.x() : local.min.x(),
+                                  (corner & 2) ? local.max.y() : local.min.y(),
+                                  (corner & 4) ? local.max.z() : local.min.z());
+            bounds.Grow(PointToWorld(point));
+        }
+    }
+
+    inline const Bounds& GetBounds() const { return bounds; }
+
+private:
+    const GeometryGroup* group;
+
+    Eigen::Matrix3d linear;
+    Eigen::Matrix3d inverse_linear;
+    Eigen::Matrix3d normal_matrix; // Inverse transpose, keeps normals perpendicular under non uniform scale
+    Eigen::Vector3d translation;
+    bool identity = false;
+
+    Bounds bounds; // In world space
+};
+
+#endif // !INSTANCE_H
@@ -0,0 +1,141 @@
+#include "IrradianceCache.h"
+
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+
+static const unsigned int MAX_DEPTH = 16;
+
+void IrradianceCache::Reset(const Vector3d& min, const Vector3d& max, double accuracy)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    // Pads the bounds so records sitting on the scene's faces are still inside.
+    Vector3d padding = (max - min) * 0.01 + Vector3d(1e-3, 1e-3, 1e-3);
+
+    bounds_min = min - padding;
+    bounds_max = max + padding;
+    this->accuracy = accuracy;
+    size = 0;
+
+    double diagonal = (max - min).norm();
+    min_radius = diagonal * 0.002;
+    max_radius = diagonal * 0.1;
+
+    root = std::make_unique<Node>();
+}
+
+bool IrradianceCache::Lookup(const Vector3d& position, const Vector3d& normal, Color& out_irradiance) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+
+    if (!root) return false;
+
+    double total_weight = 0.0;
+    double irradiance[3] = { 0.0, 0.0, 0.0 };
+
+    const Node* node = root.get();
+    Vector3d node_min = bounds_min, node_max = bounds_max;
+
+    // Walks down the cells that hold the position, every record overlapping it was added to one of them.
+    while (node != nullptr)
+    {
+        for (const IrradianceRecord& record : node->records)
+        {
+            Vector3d offset = position - record.position;
+
+            double normal_dot = normal.dot(record.normal);
+            if (normal_dot < 0.01) continue; // Faces another way
+
+            // Record sits in front of the position, it cannot see what lights it.
+            if (offset.dot(normal + record.normal) * 0.5 < -0.05 * record.radius) continue;
+
+            double error = offset.norm() / record.radius + std::sqrt(std::max(0.0, 1.0 - normal_dot));
+            if (error >= accuracy) continue;
+
+            double weight = 1.0 / std::max(error, 1e-6);
+
+            Vector3d rotation = record.normal.cross(normal);
+            float channels[3] = { record.irradiance.r, record.irradiance.g, record.irradiance.b };
+
+            for (int c = 0; c < 3; c++)
+            {
+                irradiance[c] += weight * (channels[c] + rotation.dot(record.rotation_gradient[c]) + offset.dot(record.translation_gradient[c]));
+            }
+
+            total_weight += weight;
+        }
+
+        unsigned int child = 0;
+        Vector3d mid = (node_min + node_max) * 0.5;
+
+        if (position.x() > mid.x()) child |= 1;
+        if (position.y() > mid.y()) child |= 2;
+        if (position.z() > mid.z()) child |= 4;
+
+        ChildBounds(child, node_min, node_max, node_min, node_max);
+        node = node->children[child].get();
+    }
+
+    if (total_weight <= 0.0) return false;
+
+    out_irradiance = Color(
+        (float)std::max(0.0, irradiance[0] / total_weight),
+        (float)std::max(0.0, irradiance[1] / total_weight),
+        (float)std::max(0.0, irradiance[2] / total_weight));
+
+    return true;
+}
+
+void IrradianceCache::Insert(const IrradianceRecord& record)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    if (!root) return;
+
+    // Area where the record's error estimate stays under the accuracy.
+    Vector3d reach = Vector3d::Constant(accuracy * record.radius);
+
+    Add(*root, bounds_min, bounds_max, record, record.position - reach, record.position + reach, 0);
+    size++;
+}
+
+size_t IrradianceCache::Size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return size;
+}
+
+void IrradianceCache::Add(Node& node, const Vector3d& node_min, const Vector3d& node_max, const IrradianceRecord& record, const Vector3d& record_min, const Vector3d& record_max, unsigned int depth)
+{
+    // Stops at the first cell smaller than the record's reach.
+    if (depth == MAX_DEPTH || (node_max - node_min).squaredNorm() < (record_max - record_min).squaredNorm())
+    {
+        node.records.push_back(record);
+        return;
+    }
+
+    for (unsigned int child = 0; child < 8; child++)
+    {
+        Vector3d child_min, child_max;
+        ChildBounds(child, node_min, node_max, child_min, child_max);
+
+        bool overlaps = (record_min.array() <= child_max.array()).all() && (record_max.array() >= child_min.array()).all();
+        if (!overlaps) continue;
+
+        if (!node.children[child]) node.children[child] = std::make_unique<Node>();
+
+        Add(*node.children[child], child_min, child_max, record, record_min, record_max, depth + 1);
+    }
+}
+
+void IrradianceCache::ChildBounds(unsigned int child, const Vector3d& node_min, const Vector3d& node_max, Vector3d& out_min, Vector3d& out_max)
+{
+    Vector3d mid = (node_min + node_max) * 0.5;
+
+    Vector3d child_min((child & 1) ? mid.x() : node_min.x(), (child & 2) ? mid.y() : node_min.y(), (child & 4) ? mid.z() : node_min.z());
+    Vector3d child_max((child & 1) ? node_max.x() : mid.x(), (child & 2) ? node_max.y() : mid.y(), (child & 4) ? node_max.z() : mid.z());
+
+    out_min = child_min;
+    out_max = child_max;
+}
@@ -0,0 +1,70 @@
+#ifndef IRRADIANCE_CACHE_H
+#define IRRADIANCE_CACHE_H
+
+#include <memory>
+#include <vector>
+#include <shared_mutex>
+#include <cfloat>
+
+#include "EigenIncludes.h"
+#include "Color.h"
+
+using namespace Eigen;
+
+// Irradiance sample at a point, stored as E / PI so albedo * irradiance is the reflected diffuse light.
+struct IrradianceRecord
+{
+    Vector3d position;
+    Vector3d normal;
+    Color irradiance;
+    double radius = 0.0; // Harmonic mean distance to the surrounding geometry
+
+    // Ward & Heckbert gradients, one vector per color channel.
+    Vector3d rotation_gradient[3];
+    Vector3d translation_gradient[3];
+};
+
+// Ward style irradiance cache, records live in an octree shared by every tracing thread.
+class IrradianceCache
+{
+public:
+    IrradianceCache() {}
+
+    // Empties the cache, min & max bound the positions that will be stored.
+    void Reset(const Vector3d& min, const Vector3d& max, double accuracy);
+
+    // Interpolates every record whose error estimate is under the accuracy, false when none is close enough.
+    bool Lookup(const Vector3d& position, const Vector3d& normal, Color& out_irradiance) const;
+
+    void Insert(const IrradianceRecord& record);
+
+    size_t Size() const;
+    double Accuracy() const { return accuracy; }
+
+    // Bounds of a record's radius, relative to the size of the scene.
+    double MinRadius() const { return min_radius; }
+    double MaxRadius() const { return max_radius; }
+
+private:
+    struct Node
+    {
+        std::vector<IrradianceRecord> records;
+        std::unique_ptr<Node> children[8];
+    };
+
+    void Add(Node& node, const Vector3d& node_min, const Vector3d& node_max, const IrradianceRecord& record, const Vector3d& record_min, const Vector3d& record_max, unsigned int depth);
+
+    static void ChildBounds(unsigned int child, const Vector3d& node_min, const Vector3d& node_max, Vector3d& out_min, Vector3d& out_max);
+
+private:
+    std::unique_ptr<Node> root;
+    Vector3d bounds_min, bounds_max;
+    double accuracy = 0.2;
+    double min_radius = 0.0;
+    double max_radius = DBL_MAX;
+    size_t size = 0;
+
+    mutable std::shared_mutex mutex;
+};
+
+#endif // !IRRADIANCE_CACHE_H
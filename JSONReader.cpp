@@ -9,7 +9,12 @@
 #include "Sphere.h"
 #include "Rectangle.h"
 #include "Output.h"
+#include "FeatureBuffers.h"
 #include "Scene.h"
+#include "YuMath.h"
+
+#include <algorithm>
+#include <map>
 
 using namespace Eigen;
 
@@ -24,8 +29,200 @@ nlohmann::basic_json<>::value_type JSONGetValue(nlohmann::json& j, std::string v
     }
 }
 
-void JSONReadGeometries(std::vector<Geometry*>& scene_geo, nlohmann::json& geometries)
+// Reads a flag without the missing key warning, for the counting passes.
+static bool JSONGetFlag(const nlohmann::json& j, const std::string& key, bool default_value)
+{
+    return j.contains(key) ? (bool)j.at(key) : default_value;
+}
+
+static size_t JSONCountType(const nlohmann::json& items, const std::string& type, const std::string& flag)
+{
+    size_t count = 0;
+
+    for (auto& item : items)
+    {
+        if (item.contains("type") && item.at("type") == type && JSONGetFlag(item, flag, true)) count++;
+    }
+
+    return count;
+}
+
+// Counts the visible items of a type, the ones inside groups included.
+static size_t JSONCountGeometry(const nlohmann::json& geometries, const std::string& type)
+{
+    size_t count = JSONCountType(geometries, type, "visible");
+
+    for (auto& item : geometries)
+    {
+        if (item.contains("type") && item.at("type") == "group" && item.contains("geometry") && JSONGetFlag(item, "visible", true))
+        {
+            count += JSONCountType(item.at("geometry"), type, "visible");
+        }
+    }
+
+    return count;
+}
+
+static Vector3d JSONReadVector(const nlohmann::json& value)
+{
+    return Vector3d((double)value.at(0), (double)value.at(1), (double)value.at(2));
+}
+
+static Color JSONReadColor(const nlohmann::json& value)
+{
+    return Color((float)value.at(0), (float)value.at(1), (float)value.at(2));
+}
+
+// The corners "p1" to "p4" of a rectangle or an area light.
+static void JSONReadCorners(const nlohmann::json& value, Vector3d out_points[4])
+{
+    for (int i = 0; i < 4; i++) out_points[i] = JSONReadVector(value.at("p" + std::to_string(i + 1)));
+}
+
+static const char* JSONAnimatedName(AnimatedType type)
+{
+    switch (type)
+    {
+    case AnimatedType::Sphere: return "sphere";
+    case AnimatedType::Rectangle: return "rectangle";
+    case AnimatedType::Instance: return "instance";
+    case AnimatedType::PointLight: return "point light";
+    case AnimatedType::AreaLight: return "area light";
+    case AnimatedType::Output: return "output";
+    default: return "";
+    }
+}
+
+// Properties that may be keyframed, the shape and placement ones. Materials and render settings stay as they are.
+static bool JSONAnimatable(AnimatedType type, const std::string& property)
+{
+    static const std::vector<std::string> properties[] = {
+        { "centre", "radius" },
+        { "p1", "p2", "p3", "p4" },
+        { "translate", "rotate", "scale", "transform" },
+        { "centre", "id", "is" },
+        { "p1", "p2", "p3", "p4", "id", "is" },
+        { "centre", "lookat", "up", "fov", "ai", "bkc" }
+    };
+
+    const std::vector<std::string>& allowed = properties[(int)type];
+    return std::find(allowed.begin(), allowed.end(), property) != allowed.end();
+}
+
+// "keyframes" is a list of keys, each with a "frame" and the values the properties take at that frame:
+//     "keyframes": [ {"frame": 0, "rotate": [0, 0, 0]}, {"frame": 120, "rotate": [0, 360, 0]} ]
+// A property keeps the value of the element in the frames it has no key for.
+static void JSONReadKeyframes(Scene& scene, const nlohmann::json& value, AnimatedElement element)
+{
+    if (!scene.GetSequence().IsSequence())
+    {
+        std::cout << "WARNING: Keyframes without a sequence section are ignored." << std::endl;
+        return;
+    }
+
+    element.base = value;
+    element.base.erase("keyframes");
+
+    if (value.contains("keyframes"))
+    {
+        for (auto& key : value.at("keyframes"))
+        {
+            double frame = (double)key.at("frame");
+
+            for (auto& item : key.items())
+            {
+                if (item.key() == "frame") continue;
+
+                if (!JSONAnimatable(element.type, item.key()))
+                {
+                    std::cout << "WARNING: \'" << item.key() << "\' of a " << JSONAnimatedName(element.type) << " can't be keyframed." << std::endl;
+                    continue;
+                }
+
+                auto track = std::find_if(element.tracks.begin(), element.tracks.end(), [&](const Track& t) { return t.property == item.key(); });
+                if (track == element.tracks.end())
+                {
+                    element.tracks.emplace_back();
+                    track = element.tracks.end() - 1;
+
+                    track->property = item.key();
+                    track->scalar = item.value().is_number();
+                }
+
+                std::vector<double> values;
+                if (item.value().is_number()) values.push_back((double)item.value());
+                else for (auto& number : item.value()) values.push_back((double)number);
+
+                if (item.value().is_number() != track->scalar || (!track->values.empty() && track->values[0].size() != values.size()))
+                {
+                    std::cout << "WARNING: Key of \'" << item.key() << "\' at frame " << frame << " doesn't have the size of the others, it is ignored." << std::endl;
+                    continue;
+                }
+
+                // Keys may come in any order.
+                size_t at = std::upper_bound(track->frames.begin(), track->frames.end(), frame) - track->frames.begin();
+                track->frames.insert(track->frames.begin() + at, frame);
+                track->values.insert(track->values.begin() + at, values);
+            }
+        }
+    }
+
+    scene.GetAnimated().push_back(std::move(element));
+}
+
+// "scale" (a number or one per axis), "rotate" (degrees around x, then y, then z) and "translate" are applied in that order.
+// A "transform" of 12 numbers, the rows of a 3x4 matrix, replaces them.
+static void JSONReadTransform(const nlohmann::json& value, Matrix3d& out_linear, Vector3d& out_translation)
+{
+    out_linear = Matrix3d::Identity();
+    out_translation = Vector3d::Zero();
+
+    if (value.contains("transform"))
+    {
+        auto& rows = value.at("transform");
+
+        for (int row = 0; row < 3; row++)
+        {
+            for (int column = 0; column < 3; column++) out_linear(row, column) = (double)rows.at(row * 4 + column);
+            out_translation[row] = (double)rows.at(row * 4 + 3);
+        }
+
+        return;
+    }
+
+    if (value.contains("scale"))
+    {
+        auto& scale = value.at("scale");
+        out_linear = (scale.is_number() ? Vector3d::Constant((double)scale) : JSONReadVector(scale)).asDiagonal();
+    }
+
+    if (value.contains("rotate"))
+    {
+        Vector3d degrees = JSONReadVector(value.at("rotate"));
+
+        out_linear = (AngleAxisd(Deg2Rad * degrees.z(), Vector3d::UnitZ())
+                    * AngleAxisd(Deg2Rad * degrees.y(), Vector3d::UnitY())
+                    * AngleAxisd(Deg2Rad * degrees.x(), Vector3d::UnitX())).toRotationMatrix() * out_linear;
+    }
+
+    if (value.contains("translate")) out_translation = JSONReadVector(value.at("translate"));
+}
+
+// The arenas are sized by counting passes, an object that doesn't fit means the counting and the reading disagree.
+static bool JSONCreated(const void* object, const std::string& kind)
+{
+    if (object != nullptr) return true;
+
+    std::cout << "ERROR: More " << kind << " than counted, the scene can't be built." << std::endl;
+    return false;
+}
+
+// Reads the spheres and rectangles of geometries into the group. Groups and instances are left to the caller.
+// Returns false when the material table or an arena is full.
+static bool JSONReadPrimitives(Scene& scene, nlohmann::json& geometries, GeometryGroup& group)
 {
+    std::vector<Geometry*>& scene_geo = scene.GetGeometries();
+
     for (auto& item : geometries.items())
     {
         auto& value = item.value();
@@ -34,7 +231,8 @@ void JSONReadGeometries(std::vector<Geometry*>& scene_geo, nlohmann::json& geome
         if (!isVisible) continue;
 
         std::string type = (std::string)value.at("type");
-        std::string name = (JSONGetValue(value, "comment") != nullptr) ? JSONGetValue(value, "comment") : "";
+
+        if (type.compare("group") == 0 || type.compare("instance") == 0) continue;
 
         auto& val_ac = value.at("ac");
         auto& val_dc = value.at("dc");
@@ -49,23 +247,22 @@ void JSONReadGeometries(std::vector<Geometry*>& scene_geo, nlohmann::json& geome
         float ks = (float)value.at("ks");
         float pc = (float)value.at("pc");
 
-        if (type.compare("rectangle") == 0)
+        uint16_t material;
+        if (!scene.GetMaterials().Add(Material(ac, dc, sc, ka, kd, ks, pc), material))
         {
-            Vector3d points[4];
-
-            for (int i = 0; i < 4; i++) // read the 4 points
-            {
-                auto& val_p = value.at("p" + std::to_string(i + 1));
+            std::cout << "ERROR: More than " << MaterialTable::MAX_MATERIALS << " different materials, the scene can't be built." << std::endl;
+            return false;
+        }
 
-                auto x = (double)val_p.at(0);
-                auto y = (double)val_p.at(1);
-                auto z = (double)val_p.at(2);
+        Geometry* geo = nullptr;
 
-                points[i] = Vector3d(x, y, z);
-            }
-            Rectangle* rect = new Rectangle(type, name, ka, kd, ks, pc, ac, dc, sc, points[0], points[1], points[2], points[3]);
+        if (type.compare("rectangle") == 0)
+        {
+            Vector3d points[4];
+            JSONReadCorners(value, points);
 
-            scene_geo.push_back((Geometry*)rect);
+            geo = scene.GetRectangles().Create(material, points[0], points[1], points[2], points[3]);
+            if (!JSONCreated(geo, "rectangles")) return false;
         }
         else if (type.compare("sphere") == 0)
         {
@@ -75,18 +272,125 @@ void JSONReadGeometries(std::vector<Geometry*>& scene_geo, nlohmann::json& geome
 
             Vector3d center((double)val_p.at(0), (double)val_p.at(1), (double)val_p.at(2));
 
-            Sphere* sphere = new Sphere(type, name, ka, kd, ks, pc, ac, dc, sc, center, radius);
-            scene_geo.push_back((Geometry*)sphere);
+            geo = scene.GetSpheres().Create(material, center, radius);
+            if (!JSONCreated(geo, "spheres")) return false;
         }
         else
         {
             std::cout << "WARNING: Unkown geometry \'" << type << '\'' << std::endl;
+            continue;
+        }
+
+        geo->SetId((unsigned int)scene_geo.size());
+        scene_geo.push_back(geo);
+        group.geometries.push_back(geo);
+
+        if (value.contains("keyframes"))
+        {
+            AnimatedElement element;
+            element.type = geo->GetType() == GeometryType::Sphere ? AnimatedType::Sphere : AnimatedType::Rectangle;
+            element.geometry = geo;
+            element.group = &group;
+
+            JSONReadKeyframes(scene, value, element);
         }
     }
+
+    return true;
 }
 
-void JSONReadLights(std::vector<Light*>& scene_lights, nlohmann::json& lights)
+bool JSONReadGeometries(Scene& scene, nlohmann::json& geometries)
 {
+    std::vector<Geometry*>& scene_geo = scene.GetGeometries();
+
+    // Sized once so every sphere and rectangle sits next to the others of its type.
+    scene.GetSpheres().Reserve(JSONCountGeometry(geometries, "sphere"));
+    scene.GetRectangles().Reserve(JSONCountGeometry(geometries, "rectangle"));
+    scene_geo.reserve(scene.GetSpheres().Capacity() + scene.GetRectangles().Capacity());
+
+    // One more of each for the loose geometry, placed as is.
+    scene.GetGroups().Reserve(JSONCountType(geometries, "group", "visible") + 1);
+    scene.GetInstances().Reserve(JSONCountType(geometries, "instance", "visible") + 1);
+
+    GeometryGroup* root = scene.GetGroups().Create();
+    if (!JSONCreated(root, "groups") || !JSONReadPrimitives(scene, geometries, *root)) return false;
+
+    if (!root->geometries.empty())
+    {
+        Instance* loose = scene.GetInstances().Create(*root, Matrix3d::Identity(), Vector3d::Zero());
+        if (!JSONCreated(loose, "instances")) return false;
+    }
+
+    std::map<std::string, GeometryGroup*> groups;
+
+    for (auto& item : geometries.items())
+    {
+        auto& value = item.value();
+
+        if (!JSONGetFlag(value, "visible", true) || value.at("type") != "group") continue;
+
+        GeometryGroup* group = scene.GetGroups().Create();
+        if (!JSONCreated(group, "groups")) return false;
+
+        group->name = (std::string)value.at("name");
+
+        if (!JSONReadPrimitives(scene, value.at("geometry"), *group)) return false;
+
+        for (auto& member : value.at("geometry"))
+        {
+            if (member.contains("type") && (member.at("type") == "group" || member.at("type") == "instance"))
+            {
+                std::cout << "WARNING: Group \'" << group->name << "\' holds a " << (std::string)member.at("type") << ", groups only hold spheres and rectangles." << std::endl;
+            }
+        }
+
+        if (!groups.emplace(group->name, group).second) std::cout << "WARNING: Group \'" << group->name << "\' is defined twice, the first one is used." << std::endl;
+    }
+
+    // Instances may come before the group they place.
+    for (auto& item : geometries.items())
+    {
+        auto& value = item.value();
+
+        if (!JSONGetFlag(value, "visible", true) || value.at("type") != "instance") continue;
+
+        std::string name = (std::string)value.at("group");
+        auto found = groups.find(name);
+
+        if (found == groups.end())
+        {
+            std::cout << "WARNING: Instance of unknown group \'" << name << '\'' << std::endl;
+            continue;
+        }
+
+        Matrix3d linear;
+        Vector3d translation;
+        JSONReadTransform(value, linear, translation);
+
+        Instance* instance = scene.GetInstances().Create(*found->second, linear, translation);
+        if (!JSONCreated(instance, "instances")) return false;
+
+        if (value.contains("keyframes"))
+        {
+            AnimatedElement element;
+            element.type = AnimatedType::Instance;
+            element.instance = instance;
+
+            JSONReadKeyframes(scene, value, element);
+        }
+    }
+
+    return true;
+}
+
+bool JSONReadLights(Scene& scene, nlohmann::json& lights)
+{
+    std::vector<Light*>& scene_lights = scene.GetLights();
+
+    scene.GetAreaLights().Reserve(JSONCountType(lights, "area", "use"));
+    scene.GetPointLights().Reserve(JSONCountType(lights, "point", "use"));
+    scene_lights.reserve(scene.GetAreaLights().Capacity() + scene.GetPointLights().Capacity());
+
     for (auto& item : lights.items())
     {
         auto& value = item.value();
@@ -101,23 +405,23 @@ void JSONReadLights(std::vector<Light*>& scene_lights, nlohmann::json& lights)
 
         if (!use) continue;
 
+        Light* light = nullptr;
+        AnimatedType animated_type = AnimatedType::PointLight;
+
         if (type.compare("area") == 0)
         {
             Vector3d points[4];
-
-            for (int i = 0; i < 4; i++) // read the 4 points
-            {
-                auto& val_p = value.at("p" + std::to_string(i + 1));
-                points[i] = Vector3d((double)val_p.at(0), (double)val_p.at(1), (double)val_p.at(2));
-            }
+            JSONReadCorners(value, points);
 
             bool use_center = (JSONGetValue(value, "usecenter") != nullptr) ? (bool)JSONGetValue(value, "usecenter") : false;
 
             unsigned int n = (JSONGetValue(value, "n") != nullptr) ? (unsigned int)JSONGetValue(value, "n") : 4;
 
-            AreaLight* area = new AreaLight(type, id, is, points[0], points[1], points[2], points[3], use_center, n);
+            AreaLight* area = scene.GetAreaLights().Create(type, id, is, points[0], points[1], points[2], points[3], use_center, n);
+            if (!JSONCreated(area, "area lights")) return false;
 
-            scene_lights.push_back((Light*)area);
+            light = (Light*)area;
+            animated_type = AnimatedType::AreaLight;
         }
         else if (type.compare("point") == 0)
         {
@@ -125,18 +429,38 @@ void JSONReadLights(std::vector<Light*>& scene_lights, nlohmann::json& lights)
 
             Vector3d center((double)val_p.at(0), (double)val_p.at(1), (double)val_p.at(2));
 
-            PointLight* point = new PointLight(type, id, is, center);
-            scene_lights.push_back((Light*)point);
+            PointLight* point = scene.GetPointLights().Create(type, id, is, center);
+            if (!JSONCreated(point, "point lights")) return false;
+            light = (Light*)point;
         }
         else
         {
             std::cout << "WARNING: Unkown light type \'" << type << '\'' << std::endl;
+            continue;
+        }
+
+        scene_lights.push_back(light);
+
+        if (value.contains("keyframes"))
+        {
+            AnimatedElement element;
+            element.type = animated_type;
+            element.light = light;
+
+            JSONReadKeyframes(scene, value, element);
         }
     }
+
+    return true;
 }
 
-void JSONReadOutput(std::vector<Output*>& scene_outputs, nlohmann::json& outputs)
+void JSONReadOutput(Scene& scene, nlohmann::json& outputs)
 {
+    std::vector<Output*>& scene_outputs = scene.GetOutputs();
+
+    scene.GetOutputStorage().Reserve(outputs.size());
+    scene_outputs.reserve(outputs.size());
+
     for (auto& item : outputs.items())
     {
         nlohmann::json value = item.value();
@@ -164,32 +488,134 @@ void JSONReadOutput(std::vector<Output*>& scene_outputs, nlohmann::json& outputs
         (JSONGetValue(value, "antialiasing") != nullptr) ? data.antialiasing = (bool)(JSONGetValue(value, "antialiasing")) : data.antialiasing = false;
         (JSONGetValue(value, "probterminate") != nullptr) ? data.probe_terminate = (double)(JSONGetValue(value, "probterminate")) : data.probe_terminate = 1.0f; //100% of killing itself
         (JSONGetValue(value, "maxbounces") != nullptr) ? data.max_bounce = (uint8_t)(JSONGetValue(value, "maxbounces")) : data.max_bounce = 0;
-        if (JSONGetValue(value, "raysperpixel") != nullptr)
+        (JSONGetValue(value, "irradiancecache") != nullptr) ? data.irradiance_cache = (bool)(JSONGetValue(value, "irradiancecache")) : data.irradiance_cache = false;
+        if (JSONGetValue(value, "icaccuracy") != nullptr) data.cache_accuracy = (double)(JSONGetValue(value, "icaccuracy"));
+        if (JSONGetValue(value, "icsamples") != nullptr) data.cache_samples = (unsigned int)(JSONGetValue(value, "icsamples"));
+        (JSONGetValue(value, "photonmap") != nullptr) ? data.photon_map = (bool)(JSONGetValue(value, "photonmap")) : data.photon_map = false;
+        if (JSONGetValue(value, "photons") != nullptr) data.photon_count = (unsigned int)(JSONGetValue(value, "photons"));
+        if (JSONGetValue(value, "photonpasses") != nullptr) data.photon_passes = std::max(1u, (unsigned int)(JSONGetValue(value, "photonpasses")));
+        if (JSONGetValue(value, "photonradius") != nullptr) data.photon_radius = (double)(JSONGetValue(value, "photonradius"));
+        if (JSONGetValue(value, "photonalpha") != nullptr) data.photon_alpha = (double)(JSONGetValue(value, "photonalpha"));
+        (JSONGetValue(value, "denoise") != nullptr) ? data.denoise = (bool)(JSONGetValue(value, "denoise")) : data.denoise = false;
+        if (JSONGetValue(value, "denoiseiterations") != nullptr) data.denoise_iterations = (unsigned int)(JSONGetValue(value, "denoiseiterations"));
+        (JSONGetValue(value, "tiledoutput") != nullptr) ? data.tiled_output = (bool)(JSONGetValue(value, "tiledoutput")) : data.tiled_output = false;
+        if (JSONGetValue(value, "aovs") != nullptr)
         {
-            auto val_ray_per_pixel = JSONGetValue(value, "raysperpixel");
-
-            unsigned int* a = nullptr;
-            unsigned int* b = nullptr;
-            unsigned int* c = nullptr;
+            data.aovs = 0;
 
-            try { a = new unsigned int(val_ray_per_pixel.at(0)); }
-            catch (std::exception e) { std::cout << "A doesn't exist." << std::endl; }
+            for (auto& val_aov : JSONGetValue(value, "aovs"))
+            {
+                unsigned int aov = AOVFromName((std::string)val_aov);
 
-            try { b = new unsigned int(val_ray_per_pixel.at(1)); }
-            catch (std::exception e) { std::cout << "B doesn't exist." << std::endl; }
+                if (aov == 0) std::cout << "Unknown AOV " << val_aov << " is ignored." << std::endl;
+                data.aovs |= aov;
+            }
+        }
+        if (JSONGetValue(value, "raysperpixel") != nullptr)
+        {
+            auto val_ray_per_pixel = JSONGetValue(value, "raysperpixel");
 
-            try { c = new unsigned int(val_ray_per_pixel.at(2)); }
-            catch (std::exception e) { std::cout << "C doesn't exist." << std::endl; }
+            data.rays_per_pixel_count = (unsigned int)std::min<size_t>(val_ray_per_pixel.size(), 3);
 
-            data.grid_a = a;
-            data.grid_b = b;
-            data.grid_c = c;
+            for (unsigned int i = 0; i < data.rays_per_pixel_count; i++) data.rays_per_pixel[i] = val_ray_per_pixel.at(i);
         }
 
-        Output* output = new Output();
+        Output* output = scene.GetOutputStorage().Create();
         output->Set(data);
 
         //std::cout << *output << std::endl;
         scene_outputs.push_back(output);
+
+        // Every output of a sequence is animated, if only for the frame number in its file name.
+        if (scene.GetSequence().IsSequence() || value.contains("keyframes"))
+        {
+            AnimatedElement element;
+            element.type = AnimatedType::Output;
+            element.output = output;
+
+            JSONReadKeyframes(scene, value, element);
+        }
+    }
+}
+
+// "sequence": {"frames": 120, "start": 0, "rebuildratio": 1.5}, every frame of a sequence saves its outputs as name_0000.ppm
+// and up. The elements move by their "keyframes".
+void JSONReadSequence(Scene& scene, nlohmann::json& sequence)
+{
+    SequenceSettings& settings = scene.GetSequence();
+
+    settings.frames = (unsigned int)sequence.at("frames");
+    if (sequence.contains("start")) settings.start = (unsigned int)sequence.at("start");
+    if (sequence.contains("rebuildratio")) settings.rebuild_ratio = std::max(1.0, (double)sequence.at("rebuildratio"));
+}
+
+void JSONApplyFrame(Scene& scene, unsigned int frame)
+{
+    for (AnimatedElement& element : scene.GetAnimated())
+    {
+        nlohmann::json value = element.base;
+        for (const Track& track : element.tracks) value[track.property] = track.Evaluate(frame);
+
+        if (element.type == AnimatedType::Sphere)
+        {
+            Geometry* geo = element.geometry;
+            unsigned int id = geo->GetId();
+
+            *(Sphere*)geo = Sphere(geo->GetMaterial(), JSONReadVector(value.at("centre")), (double)value.at("radius"));
+
+            geo->SetId(id);
+            element.group->moved = true;
+        }
+        else if (element.type == AnimatedType::Rectangle)
+        {
+            Geometry* geo = element.geometry;
+            unsigned int id = geo->GetId();
+
+            Vector3d points[4];
+            JSONReadCorners(value, points);
+
+            *(Rectangle*)geo = Rectangle(geo->GetMaterial(), points[0], points[1], points[2], points[3]);
+
+            geo->SetId(id);
+            element.group->moved = true;
+        }
+        else if (element.type == AnimatedType::Instance)
+        {
+            Matrix3d linear;
+            Vector3d translation;
+            JSONReadTransform(value, linear, translation);
+
+            element.instance->SetTransform(linear, translation);
+        }
+        else if (element.type == AnimatedType::PointLight)
+        {
+            Light* light = element.light;
+
+            *(PointLight*)light = PointLight(light->GetType(), JSONReadColor(value.at("id")), JSONReadColor(value.at("is")), JSONReadVector(value.at("centre")));
+        }
+        else if (element.type == AnimatedType::AreaLight)
+        {
+            AreaLight* area = (AreaLight*)element.light;
+
+            Vector3d points[4];
+            JSONReadCorners(value, points);
+
+            *area = AreaLight(area->GetType(), JSONReadColor(value.at("id")), JSONReadColor(value.at("is")), points[0], points[1], points[2], points[3],
+                              area->GetUseCenter(), area->GetSampleCount());
+        }
+        else if (element.type == AnimatedType::Output)
+        {
+            OutputData data = element.output->GetData();
+
+            data.file_name = FrameFileName((std::string)value.at("filename"), frame);
+            data.center = JSONReadVector(value.at("centre"));
+            data.look_at = JSONReadVector(value.at("lookat"));
+            data.up = JSONReadVector(value.at("up"));
+            data.fov = (float)value.at("fov");
+            data.ai = JSONReadColor(value.at("ai"));
+            data.bkc = JSONReadColor(value.at("bkc"));
+
+            element.output->Set(data);
+        }
     }
 }
@@ -14,7 +14,7 @@ public:
     {
     }
 
-    Light(std::string type, Color id, Color is)
+    Light(std::string type, const Color& id, const Color& is)
         : type(type), id(id), is(is)
     {
     }
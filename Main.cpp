@@ -3,17 +3,32 @@
 #include <sstream>
 #include <fstream>
 #include <string>
-#include <ctime>
+#include <chrono>
 
 #include "RayTracer.h"
+#include "Timeline.h"
+#include "PerfCounters.h"
 
 #include "external/json.hpp"
 
 
 Scene* LoadScene(std::string&);
 
-int main()
+// usage: Raytracer [--timeline file.json] [--perf]
+int main(int argc, char** argv)
 {
+    std::string timeline_file;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+
+        if (argument == "--timeline" && i + 1 < argc) timeline_file = argv[++i];
+        else if (argument == "--perf") PerfCounters::Enable(true); // Hardware counters in the statistics, needs RAYTRACER_STATS
+    }
+
+    if (!timeline_file.empty()) Timeline::Enable(true);
+
     //std::string files[] = {"cornell_box_empty_pl"};
     //std::string files[] = {"cornell_box"};
     //std::string files[] = { "cornell_box_al" };
@@ -46,17 +61,34 @@ int main()
             return -1;
         }
 
-        std::stringstream buffer;
-        buffer << t.rdbuf();
+        nlohmann::json j;
+
+        {
+            TIMELINE_SCOPE("ParseJSON");
+
+            std::stringstream buffer;
+            buffer << t.rdbuf();
 
-        nlohmann::json j = nlohmann::json::parse(buffer.str());
+            j = nlohmann::json::parse(buffer.str());
+        }
         RayTracer tracer(j);
 
-        std::clock_t time = clock();
-        tracer.run();
-        PRINT("Elapsed: " << ((float)(clock() - time) / CLOCKS_PER_SEC) << " seconds OR " << ((float)(clock() - time) / CLOCKS_PER_SEC / 60.0f) << " minutes.");
+        auto time = std::chrono::steady_clock::now();
+        if (!tracer.run())
+        {
+            PRINT("Scene " << scene_name << " could not be built!");
+            return -1;
+        }
+        float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - time).count();
+        PRINT("Elapsed: " << elapsed << " seconds OR " << (elapsed / 60.0f) << " minutes.");
 
     }
+    if (!timeline_file.empty())
+    {
+        if (Timeline::Save(timeline_file)) PRINT("Timeline saved as " << timeline_file << ", open it in chrome://tracing or ui.perfetto.dev.");
+        else PRINT("Could not save the timeline as " << timeline_file << "!");
+    }
+
     PRINT("\n>> END OF TASKS <<");
     std::cin.get();
 }
@@ -0,0 +1,117 @@
+#include "MappedImage.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedImage::~MappedImage()
+{
+	Close();
+}
+
+bool MappedImage::Open(const std::string& file_name, uint32_t width, uint32_t height)
+{
+	Close();
+
+	const std::string header = "P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n";
+	const size_t size = header.size() + (size_t)width * height * 3;
+
+#if defined(_WIN32)
+	HANDLE handle = CreateFileA(file_name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) return false;
+
+	file = handle;
+
+	LARGE_INTEGER large_size;
+	large_size.QuadPart = (LONGLONG)size;
+
+	if (!SetFilePointerEx(handle, large_size, nullptr, FILE_BEGIN) || !SetEndOfFile(handle))
+	{
+		Close();
+		return false;
+	}
+
+	file_mapping = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, large_size.HighPart, large_size.LowPart, nullptr);
+	if (file_mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mapping = (unsigned char*)MapViewOfFile(file_mapping, FILE_MAP_WRITE, 0, 0, size);
+#else
+	file = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (file < 0) return false;
+
+	if (ftruncate(file, (off_t)size) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	mapping = address != MAP_FAILED ? (unsigned char*)address : nullptr;
+#endif
+
+	if (mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	this->width = width;
+	this->height = height;
+	mapping_size = size;
+
+	std::memcpy(mapping, header.data(), header.size());
+	pixels = mapping + header.size();
+
+	return true;
+}
+
+void MappedImage::Close()
+{
+#if defined(_WIN32)
+	if (mapping != nullptr) UnmapViewOfFile(mapping);
+	if (file_mapping != nullptr) CloseHandle(file_mapping);
+	if (file != nullptr) CloseHandle(file);
+
+	file_mapping = nullptr;
+	file = nullptr;
+#else
+	if (mapping != nullptr) munmap(mapping, mapping_size);
+	if (file >= 0) close(file);
+
+	file = -1;
+#endif
+
+	mapping = nullptr;
+	pixels = nullptr;
+	mapping_size = 0;
+}
+
+void MappedImage::WriteTile(uint32_t start_x, uint32_t start_y, uint32_t tile_width, uint32_t tile_height, const Color* colors)
+{
+	if (pixels == nullptr) return;
+
+	for (uint32_t y = 0; y < tile_height; y++)
+	{
+		unsigned char* row = pixels + ((size_t)(start_y + y) * width + start_x) * 3;
+
+		for (uint32_t x = 0; x < tile_width; x++)
+		{
+			Color color = colors[(size_t)y * tile_width + x].Clamp();
+
+			row[x * 3] = (unsigned char)(255.0f * color.r);
+			row[x * 3 + 1] = (unsigned char)(255.0f * color.g);
+			row[x * 3 + 2] = (unsigned char)(255.0f * color.b);
+		}
+	}
+}
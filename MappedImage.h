@@ -0,0 +1,48 @@
+#ifndef MAPPED_IMAGE_H
+#define MAPPED_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Color.h"
+
+// Binary .ppm file mapped in memory, sized for the whole image when it is opened. Finished tiles are written
+// straight at their place in the file, so the image never has to fit in memory and only the tiles being traced do.
+class MappedImage
+{
+public:
+	MappedImage() {}
+	~MappedImage();
+
+	MappedImage(const MappedImage&) = delete;
+	MappedImage& operator=(const MappedImage&) = delete;
+
+	// Creates or truncates the file and maps it, false when the file can't be made that large or mapped.
+	bool Open(const std::string& file_name, uint32_t width, uint32_t height);
+	// Unmaps and closes the file, the image is complete once every tile was written.
+	void Close();
+
+	bool IsOpen() const { return pixels != nullptr; }
+
+	// Clamps and writes a tile of tile_width x tile_height colours stored row by row. Tiles may be written from
+	// several threads at once as long as they don't overlap.
+	void WriteTile(uint32_t start_x, uint32_t start_y, uint32_t tile_width, uint32_t tile_height, const Color* colors);
+
+private:
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	unsigned char* mapping = nullptr; // Start of the file
+	unsigned char* pixels = nullptr; // First byte after the header
+	size_t mapping_size = 0;
+
+#if defined(_WIN32)
+	void* file = nullptr;
+	void* file_mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
+
+#endif // !MAPPED_IMAGE_H
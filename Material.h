@@ -0,0 +1,91 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "Color.h"
+
+// What a material reflects, so shading can skip the lobes it doesn't have.
+enum MaterialFlags : uint8_t
+{
+    MATERIAL_DIFFUSE = 1 << 0,
+    MATERIAL_SPECULAR = 1 << 1,
+    MATERIAL_AMBIENT = 1 << 2
+};
+
+// Colours already multiplied by their coefficients, one material fills a cache line.
+struct alignas(64) Material
+{
+    Color ambient; // ac * ka
+    Color diffuse; // dc * kd, also the albedo
+    Color specular; // sc * ks
+    float phong = 0.0f; // pc
+    uint8_t flags = 0;
+
+    Material() {}
+
+    Material(const Color& ac, const Color& dc, const Color& sc, float ka, float kd, float ks, float pc)
+        : ambient(ac * ka), diffuse(dc * kd), specular(sc * ks), phong(pc)
+    {
+        if (ambient.Average() != 0.0f) flags |= MATERIAL_AMBIENT;
+        if (diffuse.Average() != 0.0f) flags |= MATERIAL_DIFFUSE;
+        if (ks != 0.0f && sc.Average() != 0.0f) flags |= MATERIAL_SPECULAR;
+    }
+
+    inline bool Has(uint8_t flag) const { return (flags & flag) != 0; }
+    inline bool IsPurelyDiffuse() const { return !Has(MATERIAL_SPECULAR); }
+};
+
+// Materials of the scene, primitives refer to them by a 16 bit index. Equal materials are stored once.
+class MaterialTable
+{
+public:
+    static const size_t MAX_MATERIALS = 1 << 16;
+
+    // Returns false when the table is full, the material then has no index.
+    bool Add(const Material& material, uint16_t& out_index)
+    {
+        Key key = {
+            material.ambient.r, material.ambient.g, material.ambient.b,
+            material.diffuse.r, material.diffuse.g, material.diffuse.b,
+            material.specular.r, material.specular.g, material.specular.b,
+            material.phong
+        };
+
+        auto found = indices.find(key);
+        if (found != indices.end())
+        {
+            out_index = found->second;
+            return true;
+        }
+
+        if (materials.size() == MAX_MATERIALS) return false;
+
+        out_index = (uint16_t)materials.size();
+        materials.push_back(material);
+        indices.emplace(key, out_index);
+
+        return true;
+    }
+
+    inline const Material& operator[](uint16_t index) const { return materials[index]; }
+    inline size_t Size() const { return materials.size(); }
+
+    void Clear()
+    {
+        materials.clear();
+        indices.clear();
+    }
+
+private:
+    typedef std::array<float, 10> Key;
+
+    std::vector<Material> materials;
+    std::map<Key, uint16_t> indices; // Finds the equal materials while loading
+};
+
+#endif // !MATERIAL_H
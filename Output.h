@@ -24,9 +24,25 @@ struct OutputData
     double probe_terminate; 
     bool antialiasing;
 
-    unsigned int* grid_a = nullptr; // a
-    unsigned int* grid_b = nullptr; // b
-    unsigned int* grid_c = nullptr; // c
+    bool irradiance_cache = false;
+    double cache_accuracy = 0.2;
+    unsigned int cache_samples = 128;
+
+    bool photon_map = false;
+    unsigned int photon_count = 200000;
+    unsigned int photon_passes = 1;
+    double photon_radius = 0.0; // 0 picks a radius from the scene size
+    double photon_alpha = 0.7;
+
+    bool denoise = false;
+    unsigned int denoise_iterations = 5;
+
+    unsigned int aovs = 0; // Mask of AOV bits
+
+    bool tiled_output = false; // Streams the tiles straight to the file instead of keeping the image in memory
+
+    unsigned int rays_per_pixel[3] = {}; // a, b, c
+    unsigned int rays_per_pixel_count = 0; // How many of a, b and c the scene gives
 };
 
 
@@ -40,9 +56,6 @@ public:
 
     ~Output() 
     { 
-        delete grid_a;
-        delete grid_b;
-        delete grid_c;
     };
     
     void Set(const OutputData& data)
@@ -62,9 +75,68 @@ public:
         max_bounce = data.max_bounce;
         probe_terminate = data.probe_terminate;
 
-        grid_a = data.grid_a;
-        grid_b = data.grid_b;
-        grid_c = data.grid_c;
+        irradiance_cache = data.irradiance_cache;
+        cache_accuracy = data.cache_accuracy;
+        cache_samples = data.cache_samples;
+
+        photon_map = data.photon_map;
+        photon_count = data.photon_count;
+        photon_passes = data.photon_passes;
+        photon_radius = data.photon_radius;
+        photon_alpha = data.photon_alpha;
+
+        denoise = data.denoise;
+        denoise_iterations = data.denoise_iterations;
+
+        aovs = data.aovs;
+
+        tiled_output = data.tiled_output;
+
+        for (unsigned int i = 0; i < 3; i++) rays_per_pixel[i] = data.rays_per_pixel[i];
+        rays_per_pixel_count = data.rays_per_pixel_count;
+    }
+
+    // What Set was given, so a few fields can be changed without going through the scene file again.
+    OutputData GetData() const
+    {
+        OutputData data;
+
+        data.file_name = file_name;
+        data.up = up;
+        data.look_at = look_at;
+        data.ai = ai;
+        data.bkc = bkc;
+        data.size = size;
+        data.center = center;
+        data.fov = fov;
+
+        data.global_illum = global_illum;
+        data.antialiasing = anti_aliase;
+
+        data.max_bounce = (uint8_t)max_bounce;
+        data.probe_terminate = probe_terminate;
+
+        data.irradiance_cache = irradiance_cache;
+        data.cache_accuracy = cache_accuracy;
+        data.cache_samples = cache_samples;
+
+        data.photon_map = photon_map;
+        data.photon_count = photon_count;
+        data.photon_passes = photon_passes;
+        data.photon_radius = photon_radius;
+        data.photon_alpha = photon_alpha;
+
+        data.denoise = denoise;
+        data.denoise_iterations = denoise_iterations;
+
+        data.aovs = aovs;
+
+        data.tiled_output = tiled_output;
+
+        for (unsigned int i = 0; i < 3; i++) data.rays_per_pixel[i] = rays_per_pixel[i];
+        data.rays_per_pixel_count = rays_per_pixel_count;
+
+        return data;
     }
 
     inline const auto& GetFileName() const { return file_name; }
@@ -89,9 +161,27 @@ public:
 
     inline auto GetMaxRayBounce() const { return max_bounce; }
 
-    inline unsigned int* GetA() const { return grid_a; }
-    inline unsigned int* GetB() const { return grid_b; }
-    inline unsigned int* GetC() const { return grid_c; }
+    inline bool UseIrradianceCache() const { return irradiance_cache; }
+    inline double GetCacheAccuracy() const { return cache_accuracy; }
+    inline unsigned int GetCacheSamples() const { return cache_samples; }
+
+    inline bool UsePhotonMap() const { return photon_map; }
+    inline unsigned int GetPhotonCount() const { return photon_count; }
+    inline unsigned int GetPhotonPasses() const { return photon_passes; }
+    inline double GetPhotonRadius() const { return photon_radius; }
+    inline double GetPhotonAlpha() const { return photon_alpha; }
+
+    inline bool Denoise() const { return denoise; }
+    inline unsigned int GetDenoiseIterations() const { return denoise_iterations; }
+
+    inline unsigned int GetAOVs() const { return aovs; }
+
+    inline bool TiledOutput() const { return tiled_output; }
+
+    inline unsigned int GetRaysPerPixelCount() const { return rays_per_pixel_count; }
+    inline unsigned int GetA() const { return rays_per_pixel[0]; }
+    inline unsigned int GetB() const { return rays_per_pixel[1]; }
+    inline unsigned int GetC() const { return rays_per_pixel[2]; }
 
     friend std::ostream& operator << (std::ostream& os, const Output& out)
     {
@@ -105,12 +195,17 @@ public:
             << "Background Color: " << out.GetBgColor() << '\n'
             << "Global Illumination: " << (out.global_illum == 1 ? "True" : "False") << '\n'
             << "Rays per pixels: (" 
-                      << (out.grid_a != nullptr ? std::to_string(*out.grid_a): "N/A" )
-                + ", " + (out.grid_b != nullptr ? std::to_string(*out.grid_b): "N/A" )
-                + ", " + (out.grid_c != nullptr ? std::to_string(*out.grid_c): "N/A" )
+                      << (out.rays_per_pixel_count > 0 ? std::to_string(out.GetA()): "N/A" )
+                + ", " + (out.rays_per_pixel_count > 1 ? std::to_string(out.GetB()): "N/A" )
+                + ", " + (out.rays_per_pixel_count > 2 ? std::to_string(out.GetC()): "N/A" )
                 + ")" << '\n'
             << "Max bounce: " <<  std::to_string(out.max_bounce) << '\n'
-            << "Probe Termination: " << std::to_string(out.probe_terminate) << '\n';
+            << "Probe Termination: " << std::to_string(out.probe_terminate) << '\n'
+            << "Irradiance Cache: " << (out.irradiance_cache ? "True" : "False") << '\n'
+            << "Photon Map: " << (out.photon_map ? "True" : "False") << '\n'
+            << "Denoise: " << (out.denoise ? "True" : "False") << '\n'
+            << "AOVs: " << out.aovs << '\n'
+            << "Tiled Output: " << (out.tiled_output ? "True" : "False") << '\n';
         return os;
     }
 
@@ -128,15 +223,31 @@ private:
 
     bool global_illum{};
     
-    unsigned int* grid_a = nullptr;
-    unsigned int* grid_b = nullptr;
-    unsigned int* grid_c = nullptr;
+    unsigned int rays_per_pixel[3] = {};
+    unsigned int rays_per_pixel_count = 0;
 
 
     unsigned int max_bounce{};
     double probe_terminate{};
     bool contains_area_light = false;
     bool anti_aliase = false;
+
+    bool irradiance_cache = false;
+    double cache_accuracy = 0.2;
+    unsigned int cache_samples = 128;
+
+    bool photon_map = false;
+    unsigned int photon_count = 200000;
+    unsigned int photon_passes = 1;
+    double photon_radius = 0.0;
+    double photon_alpha = 0.7;
+
+    bool denoise = false;
+    unsigned int denoise_iterations = 5;
+
+    unsigned int aovs = 0;
+
+    bool tiled_output = false;
 };
 
 #endif
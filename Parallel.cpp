@@ -0,0 +1,238 @@
+#include "Parallel.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Parallel
+{
+	static unsigned int thread_count = 0;
+	static std::vector<unsigned int> pinned_cpus;
+	static Usage usage;
+
+	unsigned int ThreadCount()
+	{
+		if (thread_count != 0) return thread_count;
+
+		unsigned int hardware = std::thread::hardware_concurrency();
+		return hardware != 0 ? hardware : 1;
+	}
+
+	void SetThreadCount(unsigned int count)
+	{
+		thread_count = count;
+	}
+
+	void SetPinning(const std::vector<unsigned int>& cpus)
+	{
+		pinned_cpus = cpus;
+	}
+
+	std::vector<unsigned int> AvailableCpus()
+	{
+		std::vector<unsigned int> cpus;
+
+#if defined(_WIN32)
+		DWORD_PTR process_mask = 0, system_mask = 0;
+		if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+		{
+			for (unsigned int cpu = 0; cpu < sizeof(DWORD_PTR) * 8; cpu++)
+			{
+				if (process_mask & ((DWORD_PTR)1 << cpu)) cpus.push_back(cpu);
+			}
+		}
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		{
+			for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			{
+				if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+			}
+		}
+#endif
+
+		return cpus;
+	}
+
+	static void PinCurrentThread(unsigned int cpu)
+	{
+#if defined(_WIN32)
+		if (cpu < sizeof(DWORD_PTR) * 8) SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+		(void)cpu;
+#endif
+	}
+
+	static double Seconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+	{
+		return std::chrono::duration<double>(end - start).count();
+	}
+
+	// Threads kept between the calls of For, so a render of many frames starts its workers once. Worker slot 0 is the
+	// calling thread unless pinning, the pool holds the others. It is started again when the thread count or the
+	// pinning changes.
+	class Pool
+	{
+	public:
+		~Pool() { Stop(); }
+
+		// Runs work(slot) on the slots [0, active) and returns once they are all done.
+		void Run(size_t active, const std::function<void(size_t)>& work)
+		{
+			const unsigned int workers = ThreadCount();
+			if (threads.empty() || started_workers != workers || started_cpus != pinned_cpus) Start(workers);
+
+			const bool pin = !started_cpus.empty();
+			const size_t first_slot = pin ? 0 : 1;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				task = &work;
+				active_slots = active;
+				pending = active > first_slot ? active - first_slot : 0;
+				generation++;
+			}
+			wake.notify_all();
+
+			if (!pin) work(0);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock, [&] { return pending == 0; });
+
+			task = nullptr;
+		}
+
+	private:
+		void Start(unsigned int workers)
+		{
+			Stop();
+
+			started_workers = workers;
+			started_cpus = pinned_cpus;
+
+			const bool pin = !started_cpus.empty();
+
+			// Pinned, every worker gets a thread of the pool so the calling thread keeps its affinity.
+			for (size_t slot = pin ? 0 : 1; slot < workers; slot++) threads.emplace_back(&Pool::Work, this, slot);
+		}
+
+		void Stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+
+			for (std::thread& thread : threads) thread.join();
+			threads.clear();
+
+			stopping = false;
+		}
+
+		void Work(size_t slot)
+		{
+			if (!started_cpus.empty()) PinCurrentThread(started_cpus[slot % started_cpus.size()]);
+
+			uint64_t seen = 0;
+
+			while (true)
+			{
+				const std::function<void(size_t)>* work;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [&] { return stopping || generation != seen; });
+
+					if (stopping) return;
+
+					seen = generation;
+					if (slot >= active_slots) continue;
+
+					work = task;
+				}
+
+				(*work)(slot);
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--pending == 0) done.notify_one();
+			}
+		}
+
+		std::vector<std::thread> threads;
+		unsigned int started_workers = 0;
+		std::vector<unsigned int> started_cpus;
+
+		std::mutex mutex;
+		std::condition_variable wake; // A new call or the stop
+		std::condition_variable done; // The last worker of a call finished
+		const std::function<void(size_t)>* task = nullptr;
+		size_t active_slots = 0;
+		size_t pending = 0; // Pool workers of the current call still running
+		uint64_t generation = 0;
+		bool stopping = false;
+	};
+
+	static Pool pool;
+
+	void For(size_t count, const std::function<void(size_t)>& job)
+	{
+		size_t workers = ThreadCount();
+		if (workers > count) workers = count;
+		if (workers == 0) return;
+
+		const bool pin = !pinned_cpus.empty();
+		const auto start = std::chrono::steady_clock::now();
+
+		std::vector<double> busy(workers, 0.0);
+		std::atomic<size_t> next{ 0 };
+
+		auto work = [&](size_t worker)
+		{
+			double& worker_busy = busy[worker];
+
+			for (size_t i = next++; i < count; i = next++)
+			{
+				auto job_start = std::chrono::steady_clock::now();
+				job(i);
+				worker_busy += Seconds(job_start, std::chrono::steady_clock::now());
+			}
+		};
+
+		if (workers == 1 && !pin) work(0);
+		else pool.Run(workers, work);
+
+		usage.wall += Seconds(start, std::chrono::steady_clock::now());
+
+		if (usage.busy.size() < workers) usage.busy.resize(workers, 0.0);
+		for (size_t i = 0; i < workers; i++) usage.busy[i] += busy[i];
+	}
+
+	Usage GetUsage()
+	{
+		return usage;
+	}
+
+	void ResetUsage()
+	{
+		usage = Usage();
+	}
+}
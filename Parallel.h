@@ -0,0 +1,38 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace Parallel
+{
+	// Worker threads used by For, defaults to the hardware thread count.
+	unsigned int ThreadCount();
+	void SetThreadCount(unsigned int count); // 0 goes back to the hardware thread count
+
+	// Pins worker i of For to cpus[i % cpus.size()], empty turns pinning off. The order of the list decides how the
+	// workers fill the sockets of a NUMA machine. While pinning the calling thread only waits for the workers.
+	void SetPinning(const std::vector<unsigned int>& cpus);
+	// CPUs the process may run on, in order, empty when the platform can't tell.
+	std::vector<unsigned int> AvailableCpus();
+
+	// Runs job(i) for every i in [0, count), indices are handed to the workers as they free up. The worker threads
+	// are kept waiting between calls, job must not call For itself.
+	void For(size_t count, const std::function<void(size_t)>& job);
+
+	// Seconds spent in For and, per worker slot, seconds spent running jobs. What a worker didn't spend running jobs
+	// it spent waiting for the others to finish.
+	struct Usage
+	{
+		double wall = 0.0;
+		std::vector<double> busy;
+
+		double Idle(size_t worker) const { return worker < busy.size() ? wall - busy[worker] : wall; }
+	};
+
+	Usage GetUsage();
+	void ResetUsage();
+}
+
+#endif // !PARALLEL_H
@@ -0,0 +1,150 @@
+#include "PerfCounters.h"
+#include "Statistics.h"
+
+#include <atomic>
+#include <iostream>
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace PerfCounters
+{
+	static std::atomic<bool> enabled{ false };
+	static std::atomic<bool> warned{ false };
+
+#if defined(__linux__)
+	static const uint64_t CONFIGS[EventCount] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_REFERENCES,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+
+	// One counter group per thread, the cycle counter leads it so all of them run over the same time.
+	struct ThreadCounters
+	{
+		int fds[EventCount];
+		bool opened = false;
+		bool failed = false;
+
+		ThreadCounters()
+		{
+			for (int event = 0; event < EventCount; event++) fds[event] = -1;
+		}
+
+		~ThreadCounters()
+		{
+			for (int event = 0; event < EventCount; event++) if (fds[event] >= 0) close(fds[event]);
+		}
+
+		bool Open()
+		{
+			if (opened || failed) return opened;
+
+			for (int event = 0; event < EventCount; event++)
+			{
+				perf_event_attr attr;
+				std::memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.config = CONFIGS[event];
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_ID;
+
+				// pid 0 and cpu -1 count the calling thread on any cpu.
+				fds[event] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, event == Cycles ? -1 : fds[Cycles], 0);
+
+				// Without a cycle counter there is nothing to group on, the other events are simply left at 0.
+				if (fds[Cycles] < 0)
+				{
+					failed = true;
+
+					if (!warned.exchange(true)) std::cout << ">> perf_event_open failed (" << std::strerror(errno) << "), hardware counters are off." << std::endl;
+					return false;
+				}
+			}
+
+			opened = true;
+			return true;
+		}
+	};
+
+	static thread_local ThreadCounters thread_counters;
+#endif
+
+	void Enable(bool enable)
+	{
+		enabled = enable;
+	}
+
+	bool Enabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	bool Read(Values& out_values)
+	{
+#if defined(__linux__)
+		if (!Enabled() || !thread_counters.Open()) return false;
+
+		for (int event = 0; event < EventCount; event++)
+		{
+			uint64_t value[2] = {}; // value and id
+
+			if (thread_counters.fds[event] < 0 || read(thread_counters.fds[event], value, sizeof(value)) != sizeof(value)) value[0] = 0;
+
+			out_values.counts[event] = value[0];
+		}
+
+		return true;
+#else
+		(void)out_values;
+		return false;
+#endif
+	}
+
+	const char* EventName(Event event)
+	{
+		switch (event)
+		{
+		case Cycles: return "cycles";
+		case Instructions: return "instructions";
+		case CacheReferences: return "cache_references";
+		case CacheMisses: return "cache_misses";
+		case BranchInstructions: return "branch_instructions";
+		case BranchMisses: return "branch_misses";
+		default: return "";
+		}
+	}
+
+	const char* PhaseName(Phase phase)
+	{
+		switch (phase)
+		{
+		case Build: return "build";
+		case Trace: return "trace";
+		case Save: return "save";
+		default: return "";
+		}
+	}
+
+	Scope::Scope(Phase phase)
+		: phase(phase), valid(Read(start))
+	{
+	}
+
+	Scope::~Scope()
+	{
+		Values end;
+
+		if (valid && Read(end)) Statistics::CountPerf(phase, end - start);
+	}
+}
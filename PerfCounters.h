@@ -0,0 +1,61 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+
+// Hardware counters of the calling thread through Linux perf_event_open, user space only.
+// Opt-in at run time, and a no-op on other platforms or when the kernel refuses the counters.
+namespace PerfCounters
+{
+	enum Event { Cycles, Instructions, CacheReferences, CacheMisses, BranchInstructions, BranchMisses, EventCount };
+
+	// Parts of a render the counters are read around.
+	enum Phase { Build, Trace, Save, PhaseCount };
+
+	struct Values
+	{
+		uint64_t counts[EventCount] = {};
+
+		Values& operator+=(const Values& other)
+		{
+			for (int event = 0; event < EventCount; event++) counts[event] += other.counts[event];
+			return *this;
+		}
+
+		Values operator-(const Values& other) const
+		{
+			Values difference;
+			for (int event = 0; event < EventCount; event++) difference.counts[event] = counts[event] - other.counts[event];
+			return difference;
+		}
+
+		double IPC() const { return counts[Cycles] != 0 ? (double)counts[Instructions] / counts[Cycles] : 0.0; }
+	};
+
+	void Enable(bool enable);
+	bool Enabled();
+
+	// Current counts of the calling thread, opens its counters on the first call. False when they can't be read.
+	bool Read(Values& out_values);
+
+	const char* EventName(Event event);
+	const char* PhaseName(Phase phase);
+
+	// Adds the counts between its construction and destruction to the statistics of the phase.
+	class Scope
+	{
+	public:
+		Scope(Phase phase);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		Phase phase;
+		bool valid;
+		Values start;
+	};
+}
+
+#endif // !PERF_COUNTERS_H
@@ -0,0 +1,82 @@
+#include "PhotonMap.h"
+
+#include <algorithm>
+
+void PhotonMap::Clear()
+{
+    photons.clear();
+}
+
+void PhotonMap::Store(const std::vector<Photon>& batch)
+{
+    std::lock_guard<std::mutex> lock(store_mutex);
+    photons.insert(photons.end(), batch.begin(), batch.end());
+}
+
+void PhotonMap::Build()
+{
+    Balance(0, photons.size());
+}
+
+void PhotonMap::Balance(size_t begin, size_t end)
+{
+    if (end - begin <= 1) return;
+
+    // Splits along the widest side of the range's box.
+    Vector3d min = photons[begin].position, max = photons[begin].position;
+
+    for (size_t i = begin + 1; i < end; i++)
+    {
+        min = min.cwiseMin(photons[i].position);
+        max = max.cwiseMax(photons[i].position);
+    }
+
+    Eigen::Index widest;
+    (max - min).maxCoeff(&widest);
+
+    uint8_t axis = (uint8_t)widest;
+
+    size_t mid = begin + (end - begin) / 2;
+
+    std::nth_element(photons.begin() + begin, photons.begin() + mid, photons.begin() + end,
+        [axis](const Photon& a, const Photon& b) { return a.position[axis] < b.position[axis]; });
+
+    photons[mid].axis = axis;
+
+    Balance(begin, mid);
+    Balance(mid + 1, end);
+}
+
+Color PhotonMap::Gather(const Vector3d& position, const Vector3d& normal, double radius) const
+{
+    Color power;
+    Gather(0, photons.size(), position, normal, radius * radius, power);
+    return power;
+}
+
+void PhotonMap::Gather(size_t begin, size_t end, const Vector3d& position, const Vector3d& normal, double radius_sqr, Color& out_power) const
+{
+    if (begin >= end) return;
+
+    size_t mid = begin + (end - begin) / 2;
+    const Photon& photon = photons[mid];
+
+    double split = position[photon.axis] - photon.position[photon.axis];
+
+    // Nearest side first, the far side only when the sphere crosses the split plane.
+    if (split < 0.0)
+    {
+        Gather(begin, mid, position, normal, radius_sqr, out_power);
+        if (split * split < radius_sqr) Gather(mid + 1, end, position, normal, radius_sqr, out_power);
+    }
+    else
+    {
+        Gather(mid + 1, end, position, normal, radius_sqr, out_power);
+        if (split * split < radius_sqr) Gather(begin, mid, position, normal, radius_sqr, out_power);
+    }
+
+    if ((photon.position - position).squaredNorm() < radius_sqr && photon.direction.dot(normal) < 0.0)
+    {
+        out_power += photon.power;
+    }
+}
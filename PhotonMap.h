@@ -0,0 +1,48 @@
+#ifndef PHOTON_MAP_H
+#define PHOTON_MAP_H
+
+#include <vector>
+#include <mutex>
+
+#include "EigenIncludes.h"
+#include "Color.h"
+
+using namespace Eigen;
+
+struct Photon
+{
+    Vector3d position;
+    Vector3d direction; // Direction the photon was travelling when it landed
+    Color power;
+    uint8_t axis = 0; // Split axis of its kd-tree node
+};
+
+// Photons kept as a left balanced kd-tree laid out in one array, the median of a range is its node.
+class PhotonMap
+{
+public:
+    PhotonMap() {}
+
+    void Clear();
+
+    // Can be called from several threads while emitting.
+    void Store(const std::vector<Photon>& batch);
+
+    // Balances the kd-tree, call once every photon is stored.
+    void Build();
+
+    // Sum of the power of the photons within radius that landed on the front of normal.
+    Color Gather(const Vector3d& position, const Vector3d& normal, double radius) const;
+
+    size_t Size() const { return photons.size(); }
+
+private:
+    void Balance(size_t begin, size_t end);
+    void Gather(size_t begin, size_t end, const Vector3d& position, const Vector3d& normal, double radius_sqr, Color& out_power) const;
+
+private:
+    std::vector<Photon> photons;
+    std::mutex store_mutex;
+};
+
+#endif // !PHOTON_MAP_H
@@ -15,7 +15,7 @@ private:
     Eigen::Vector3d center;
 public:
     PointLight() = delete;
-    PointLight(std::string type, Color id, Color is, Eigen::Vector3d center)
+    PointLight(std::string type, const Color& id, const Color& is, Eigen::Vector3d center)
         : Light(type, id, is), center(center)
     {
     }
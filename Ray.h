@@ -3,11 +3,25 @@
 
 #include "EigenIncludes.h"
 
-#include "Geometry.h"
+#include "Color.h"
 #include <cfloat>
+#include <cstdint>
 
 #include <iostream>
 using namespace Eigen;
+
+// Everything shading needs to know about the closest hit, filled once when the hit is found.
+struct HitRecord
+{
+    Vector3d position = Vector3d(NAN, NAN, NAN);
+    Vector3d normal = Vector3d::Zero(); // Geometric normal, also the shading normal as nothing is smooth shaded
+    double distance = INFINITY; // From the ray origin
+    double u = 0.0, v = 0.0; // Surface coordinates, both in [0, 1]
+    unsigned int primitive_id = 0; // Shared by the copies of a group's geometry
+    unsigned int instance_id = 0; // Tells the copies apart
+    uint16_t material = 0;
+};
+
 class Ray
 {
 public:
@@ -30,12 +44,7 @@ public:
     }
 
     // If hit nothing distance == INIFINITY
-    double GetHitDistance() const 
-    { 
-        if (hit_coor.hasNaN()) return INFINITY;
-
-        return (hit_coor - origin).norm(); 
-    }
+    double GetHitDistance() const { return hit.distance; }
 
     // From origin of this ray to a point
     double GetDistance(const Vector3d& point) const 
@@ -47,28 +56,17 @@ public:
     
     Vector3d GetPoint(double& distance) const { return distance * direction + origin; }
 
-    bool IsCloser(const Vector3d& point)
-    {
-        if (hit_coor.hasNaN()) return true;
-        return (GetDistance(point) < (hit_coor - origin).norm());
-    }
+    void SetClosestHit(const HitRecord& hit) { this->hit = hit; }
 
-    void SetClosestHit(const Vector3d& point, Geometry& hit_obj)
-    {
-        hit_coor = point;
-        this->hit_obj = &hit_obj;
-    }
+    const HitRecord& GetHit() const { return hit; }
 
     const Vector3d& GetHitCoor() const
     {
-        return hit_coor;
+        return hit.position;
     }
 
 private:
-    Vector3d hit_coor = Vector3d(NAN,NAN,NAN);
-
-public:
-    Geometry* hit_obj = nullptr;
+    HitRecord hit;
 
     
 public:
@@ -1,448 +1,1429 @@
 #include "RayTracer.h"
+#include "Parallel.h"
+#include "Denoiser.h"
+#include "Statistics.h"
+#include "CycleCounter.h"
+#include "Timeline.h"
 
 #include <fstream>
 
 #include <cmath>
 #include <cfloat>
+#include <algorithm>
+#include <chrono>
 
-static bool valid = true;
+// Minimum travel of a ray before it can hit something, keeps bounces from hitting their own origin.
+static const double RAY_EPSILON = 1e-4;
+
+// Side of the square pixel blocks handed to the tracing threads.
+static const uint32_t TILE_SIZE = 16;
+
+// Photons traced by one parallel job while emitting.
+static const unsigned int PHOTON_BATCH = 4096;
 
 struct Hit 
 {
     Vector3d point;
     Geometry* obj;
+    Vector3d local_point; // In the space of the instance's group
+    const Instance* instance;
+    uint32_t instance_id;
+};
+
+#pragma region Main Structure
+
+RayTracer::RayTracer(nlohmann::json json_file)
+    :json_file(json_file)
+{
+    PRINT("JSON file acquired!");
+}
+
+RayTracer::~RayTracer() {}
+
+// Wall time since start in seconds, start moves to now so the next phase can be timed with it.
+static double Lap(std::chrono::steady_clock::time_point& start)
+{
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - start).count();
+    start = now;
+
+    return seconds;
+}
+
+bool RayTracer::run()
+{
+    phase_times = PhaseTimes();
+    statistics = Statistics::Report();
+
+    auto start = std::chrono::steady_clock::now();
+
+    // The first output's statistics also hold the scene build.
+    Statistics::Reset();
+
+    if (!scene_built && !BuildScene()) return false;
+    phase_times.build += Lap(start);
+
+    // A scene without a sequence is a single frame that is never moved.
+    const SequenceSettings& sequence = scene.GetSequence();
+    const unsigned int first_frame = sequence.IsSequence() ? sequence.start : 0;
+    const unsigned int end_frame = sequence.IsSequence() ? sequence.frames : 1;
+
+    // The scene, the BVHs, the camera buffers and the worker threads are kept from one frame to the next.
+    for (unsigned int frame = first_frame; frame < end_frame; frame++)
+    {
+        if (sequence.IsSequence())
+        {
+            PRINT("Frame " << frame << " of " << sequence.frames);
+
+            SetFrame(frame);
+            phase_times.build += Lap(start);
+        }
+
+        for (Output* output : scene.GetOutputs())
+        {
+            SetupCamera(*output);
+            phase_times.setup += Lap(start);
+
+            Trace(*output);
+            phase_times.trace += Lap(start);
+
+            if (output->Denoise()) Denoise(*output);
+            phase_times.denoise += Lap(start);
+
+            if (save_outputs)
+            {
+                SaveToPPM(*output);
+                if (output->GetAOVs() != 0) SaveAOVs(*output);
+            }
+            phase_times.save += Lap(start);
+
+            Statistics::Report output_statistics = Statistics::Snapshot();
+            Statistics::Reset();
+            statistics += output_statistics;
+
+#if RAYTRACER_STATS
+            if (save_outputs) SaveStatistics(*output, output_statistics);
+#endif
+        }
+    }
+
+    return true;
+}
+
+bool RayTracer::RenderOutput(size_t output_index, std::vector<Color>& out_image)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    if (!scene_built && !BuildScene()) return false;
+    phase_times.build += Lap(start);
+
+    if (output_index >= scene.GetOutputs().size()) return false;
+
+    Output& output = *scene.GetOutputs()[output_index];
+
+    // Nothing is saved here, so a tiled output is traced in memory like the others.
+    bool save = save_outputs;
+    save_outputs = false;
+
+    SetupCamera(output);
+    phase_times.setup += Lap(start);
+
+    Trace(output);
+    phase_times.trace += Lap(start);
+
+    if (output.Denoise()) Denoise(output);
+    phase_times.denoise += Lap(start);
+
+    save_outputs = save;
+
+    out_image = Camera::GetInstance().GetOutputBuffer();
+
+    return true;
+}
+
+/// Builds scene from json file
+bool RayTracer::BuildScene()
+{
+    TIMELINE_SCOPE("BuildScene");
+    STAT_PERF_SCOPE(Build);
+
+    PRINT("Building scene...");
+
+    nlohmann::json geo = json_file.at("geometry");
+    nlohmann::json light = json_file.at("light");
+    nlohmann::json output = json_file.at("output");
+
+    scene.Clear();
+
+    // First, the readers only keep the keyframes of a sequence.
+    if (json_file.contains("sequence")) JSONReadSequence(scene, json_file.at("sequence"));
+
+    if (!JSONReadGeometries(scene, geo)) return false;
+    if (!JSONReadLights(scene, light)) return false;
+    JSONReadOutput(scene, output);
+
+    // The BVHs are built around the first frame, the others only refit them.
+    if (scene.GetSequence().IsSequence()) JSONApplyFrame(scene, scene.GetSequence().start);
+
+    {
+        TIMELINE_SCOPE("BuildBVH");
+        scene.BuildAcceleration();
+    }
+
+    scene_built = true;
+
+    //#if _DEBUG
+    //        scene->PrintGeometries();
+    //        scene->PrintLights();
+    //        scene->PrintOutput();
+    //#endif
+
+    return true;
+}
+
+void RayTracer::SetFrame(unsigned int frame)
+{
+    TIMELINE_SCOPE("SetFrame", (int64_t)frame);
+    STAT_PERF_SCOPE(Build);
+
+    JSONApplyFrame(scene, frame);
+
+    unsigned int rebuilt;
+    {
+        TIMELINE_SCOPE("RefitBVH");
+        rebuilt = scene.RefitAcceleration(scene.GetSequence().rebuild_ratio);
+    }
+
+    if (rebuilt > 0) PRINT("Rebuilt " << rebuilt << " of the BVHs, refitting had made them too loose.");
+}
+
+void RayTracer::SetupCamera(const Output& output)
+{
+    TIMELINE_SCOPE("SetupCamera");
+
+    PRINT("Setting up the camera...");
+
+    if (output.TiledOutput() && save_outputs && !StreamsTiles(output)) PRINT("Denoising, AOVs and photon mapping need the whole image, " << output.GetFileName() << " is not tiled.");
+
+    Camera::GetInstance().SetData(output, RESOLUTION, !StreamsTiles(output));
+
+    trace_kernel = SelectTraceKernel(output);
+
+    if (output.HasGlobalIllumination() && output.UseIrradianceCache())
+    {
+        Vector3d min, max;
+        scene.GetBounds(min, max);
+
+        irradiance_cache.Reset(min, max, output.GetCacheAccuracy());
+    }
+}
+
+void RayTracer::Trace(const Output& output)
+{
+    TIMELINE_SCOPE("Trace");
+
+    PRINT("Tracing...");
+
+    Camera& camera = Camera::GetInstance();
+
+    auto& output_buffer = camera.GetOutputBuffer();
+
+    tiles_streamed = false;
+
+    if (StreamsTiles(output))
+    {
+        if (tiled_image.Open(OutputPath(output.GetFileName()), camera.Width(), camera.Height()))
+        {
+            TraceTiles(output, output_buffer, &tiled_image);
+            tiled_image.Close();
+
+            tiles_streamed = true;
+            return;
+        }
+
+        // Falls back on the image in memory.
+        PRINT("Could not map " << output.GetFileName() << ", tracing it in memory.");
+        camera.SetData(output, RESOLUTION, true);
+    }
+
+    if (output.HasGlobalIllumination() && output.UsePhotonMap())
+    {
+        // Progressive photon mapping after Knaus & Zwicker: every pass renders with a fresh photon map and a smaller
+        // radius, the image is the average of the passes so only one pass worth of photons is ever in memory.
+        std::vector<Color> pass_buffer(output_buffer.size());
+        std::fill(output_buffer.begin(), output_buffer.end(), Color::Black());
+
+        // Every pass overwrites the feature buffers, the ones that change between passes are averaged like the image.
+        FeatureBuffers& features = camera.GetFeatureBuffers();
+        FeatureBuffers feature_sums;
+        feature_sums.Resize(output_buffer.size(), features.mask & FeatureBuffers::PASS_AOVS);
+
+        Vector3d min, max;
+        scene.GetBounds(min, max);
+
+        photon_radius = output.GetPhotonRadius() > 0.0 ? output.GetPhotonRadius() : (max - min).norm() * 0.01;
+
+        const unsigned int passes = output.GetPhotonPasses();
+
+        for (unsigned int pass = 1; pass <= passes; pass++)
+        {
+            EmitPhotons(output);
+            TraceTiles(output, pass_buffer);
+
+            for (size_t i = 0; i < output_buffer.size(); i++) output_buffer[i] += pass_buffer[i];
+            features.AddPassTo(feature_sums);
+
+            photon_radius *= std::sqrt((pass + output.GetPhotonAlpha()) / (pass + 1.0));
+        }
+
+        for (Color& color : output_buffer) color /= (double)passes;
+        features.SetPassAverage(feature_sums, passes);
+
+        photon_map.Clear();
+    }
+    else
+    {
+        TraceTiles(output, output_buffer);
+    }
+
+    if (output.HasGlobalIllumination() && output.UseIrradianceCache()) PRINT("Irradiance records: " << irradiance_cache.Size());
+}
+
+bool RayTracer::StreamsTiles(const Output& output) const
+{
+    if (!output.TiledOutput() || !save_outputs) return false;
+
+    return !output.Denoise() && output.GetAOVs() == 0 && !(output.HasGlobalIllumination() && output.UsePhotonMap());
+}
+
+// One kernel per combination of TraceFeatures, indexed by the combination.
+const RayTracer::TraceKernel RayTracer::trace_kernels[TRACE_KERNEL_COUNT] =
+{
+    &RayTracer::TraceTilesKernel<0>, &RayTracer::TraceTilesKernel<1>, &RayTracer::TraceTilesKernel<2>, &RayTracer::TraceTilesKernel<3>,
+    &RayTracer::TraceTilesKernel<4>, &RayTracer::TraceTilesKernel<5>, &RayTracer::TraceTilesKernel<6>, &RayTracer::TraceTilesKernel<7>,
+    &RayTracer::TraceTilesKernel<8>, &RayTracer::TraceTilesKernel<9>, &RayTracer::TraceTilesKernel<10>, &RayTracer::TraceTilesKernel<11>,
+    &RayTracer::TraceTilesKernel<12>, &RayTracer::TraceTilesKernel<13>, &RayTracer::TraceTilesKernel<14>, &RayTracer::TraceTilesKernel<15>
+};
+
+RayTracer::TraceKernel RayTracer::SelectTraceKernel(const Output& output)
+{
+    unsigned int features = 0;
+
+    bool area_lights = scene.HasAreaLight();
+
+    if ((output.HasGlobalIllumination() || output.AntiAliase()) && !area_lights) features |= TRACE_AA; // If scene has GL or AreaL then no AA
+    if (output.HasGlobalIllumination()) features |= TRACE_GI;
+    else features |= TRACE_SPECULAR; // If scene has GL then no specular light
+    if (area_lights) features |= TRACE_AREA_LIGHTS;
+
+    return trace_kernels[features];
+}
+
+void RayTracer::TraceTiles(const Output& output, std::vector<Color>& buffer, MappedImage* tiled)
+{
+    (this->*trace_kernel)(output, buffer, tiled);
+}
+
+template <unsigned int FEATURES>
+void RayTracer::TraceTilesKernel(const Output& output, std::vector<Color>& buffer, MappedImage* tiled)
+{
+    Camera& camera = Camera::GetInstance();
+
+    const uint32_t tiles_x = (camera.Width() + TILE_SIZE - 1) / TILE_SIZE;
+    const uint32_t tiles_y = (camera.Height() + TILE_SIZE - 1) / TILE_SIZE;
+
+    FeatureBuffers& features = camera.GetFeatureBuffers();
+    const bool measure_cost = features.Has(AOV_COST);
+
+    // Every tile is traced by one thread, so each pixel of the buffer has a single writer.
+    Parallel::For((size_t)tiles_x * tiles_y, [&](size_t tile)
+    {
+        TIMELINE_SCOPE("Tile", (int64_t)tile);
+        STAT_PERF_SCOPE(Trace);
+
+        uint32_t start_x = (uint32_t)(tile % tiles_x) * TILE_SIZE;
+        uint32_t start_y = (uint32_t)(tile / tiles_x) * TILE_SIZE;
+        uint32_t end_x = std::min<uint32_t>(start_x + TILE_SIZE, camera.Width());
+        uint32_t end_y = std::min<uint32_t>(start_y + TILE_SIZE, camera.Height());
+
+        std::vector<Color> tile_colors(tiled != nullptr ? (size_t)(end_x - start_x) * (end_y - start_y) : 0);
+
+        // For each height, trace its row
+        for (uint32_t y = start_y; y < end_y; y++)
+        {
+            for (uint32_t x = start_x; x < end_x; x++)
+            {
+                size_t index = (size_t)y * camera.Width() + x;
+                uint64_t start_cycles = measure_cost ? CycleCounter::Read() : 0;
+
+                Color color = TracePixel<FEATURES>(x, y, output);
+
+                if (tiled != nullptr) tile_colors[(size_t)(y - start_y) * (end_x - start_x) + (x - start_x)] = color;
+                else buffer[index] = color;
+
+                if (measure_cost) features.cost[index] += CycleCounter::Read() - start_cycles;
+            }
+        }
+
+        if (tiled != nullptr) tiled->WriteTile(start_x, start_y, end_x - start_x, end_y - start_y, tile_colors.data());
+    });
+}
+
+template <unsigned int FEATURES>
+Color RayTracer::TracePixel(uint32_t x, uint32_t y, const Output& output)
+{
+    constexpr bool use_AA = (FEATURES & TRACE_AA) != 0;
+    constexpr bool use_specular = (FEATURES & TRACE_SPECULAR) != 0;
+
+    Camera& camera = Camera::GetInstance();
+
+    Color final_ambient;
+    Color final_diffuse;
+    Color final_specular;
+
+    Vector3d px = (camera.ScaledPixel() - (2.0f * x + 1.0f) * camera.PixelCenter()) * camera.Right(); //(2.0f * y + 1.0f) == 2k + 1 aka odd number
+    Vector3d py = (camera.HalfImage() - (2.0f * y + 1.0f) * camera.PixelCenter()) * camera.Up(); //(2.0f * y + 1.0f) == 2k + 1 aka odd number
+
+    Vector3d pixel_shoot_at = camera.OriginLookAt() + px + py;
+
+    Ray ray = camera.MakeRay(pixel_shoot_at);
+    STAT_COUNT(PrimaryRays);
+    STAT_PATH_RAY(0);
+    bool hit = Raycast(ray);
+
+    Color final_indirect;
+    unsigned int sample_count = 1;
+
+    if constexpr (use_AA)
+    {
+        sample_count = 0;
+        UseMSAA<(FEATURES & TRACE_GI) != 0>(px, py, final_ambient, final_diffuse, final_indirect, sample_count, output);
+    }
+    else // No AA
+    {
+        if (hit)
+        {
+            // Both lobes see the same hit, so they share its shadow rays.
+            ShadeDirect<(FEATURES & TRACE_AREA_LIGHTS) != 0>(ray, &final_diffuse, use_specular ? &final_specular : nullptr);
+            final_ambient = GetAmbientColor(ray);
+
+            // Area lights turn the sample grid off, the indirect light of a photon mapped output still comes from the photons.
+            if constexpr ((FEATURES & TRACE_GI) != 0)
+            {
+                if (output.UsePhotonMap() && IsPurelyDiffuse(ray.GetHit()))
+                {
+                    final_indirect = GetPhotonIndirect(ray);
+                    final_diffuse += final_indirect;
+                }
+            }
+        }
+        else
+        {
+            final_ambient = output.GetBgColor();
+        }
+    }
+
+    if constexpr (use_specular && use_AA)
+    {
+        if (hit) final_specular = GetSpecularColor(ray);
+    }
+
+    Color final_color = Color::MulAdd(final_ambient, camera.AmbientIntensity(), final_diffuse + final_specular);
+
+    FeatureBuffers& features = camera.GetFeatureBuffers();
+
+    if (!features.Empty())
+    {
+        size_t index = (size_t)y * camera.Width() + x;
+
+        if (features.Has(AOV_ALBEDO)) features.albedo[index] = hit ? MaterialOf(ray.GetHit()).diffuse : output.GetBgColor();
+        if (features.Has(AOV_NORMAL) && hit) features.normal[index] = ray.GetHit().normal;
+        if (features.Has(AOV_DEPTH) && hit) features.depth[index] = ray.GetHitDistance();
+        if (features.Has(AOV_PRIMITIVE_ID) && hit)
+        {
+            features.primitive_id[index] = (int)ray.GetHit().primitive_id;
+            features.instance_id[index] = ray.GetHit().instance_id;
+        }
+        if (features.Has(AOV_DIRECT)) features.direct[index] = final_color - final_indirect;
+        if (features.Has(AOV_INDIRECT)) features.indirect[index] = final_indirect;
+        if (features.Has(AOV_SAMPLES)) features.samples[index] = sample_count;
+    }
+
+    return final_color;
+}
+
+void RayTracer::Denoise(const Output& output)
+{
+    TIMELINE_SCOPE("Denoise");
+
+    PRINT("Denoising...");
+
+    Camera& camera = Camera::GetInstance();
+
+    Denoiser::Settings settings;
+    settings.iterations = output.GetDenoiseIterations();
+
+    Denoiser::ATrous(camera.GetOutputBuffer(), camera.GetFeatureBuffers(), camera.Width(), camera.Height(), settings);
+}
+
+void RayTracer::SaveToPPM(const Output& output)
+{
+    TIMELINE_SCOPE("SaveToPPM");
+    STAT_PERF_SCOPE(Save);
+
+    if (tiles_streamed)
+    {
+        PRINT("Output was saved tile by tile as " + output.GetFileName() + ".");
+        return;
+    }
+
+    PRINT("Saving output as " + output.GetFileName() + ".");
+
+    WritePPM(output.GetFileName(), Camera::GetInstance().GetOutputBuffer());
+
+    PRINT("Done saving!");
+}
+
+void RayTracer::SaveAOVs(const Output& output)
+{
+    TIMELINE_SCOPE("SaveAOVs");
+    STAT_PERF_SCOPE(Save);
+
+    Camera& camera = Camera::GetInstance();
+    FeatureBuffers& features = camera.GetFeatureBuffers();
+
+    const size_t size = (size_t)camera.Width() * camera.Height();
+
+    std::string base_name = SideCarBaseName(output);
+
+    std::vector<Color> image(size);
+
+    for (unsigned int aov = 1; aov <= AOV_LAST; aov <<= 1)
+    {
+        if ((output.GetAOVs() & aov) == 0 || !features.Has(aov)) continue;
+
+        double max_depth = 0.0;
+        unsigned int max_samples = 1;
+
+        for (size_t i = 0; i < size && aov == AOV_DEPTH; i++) max_depth = std::max(max_depth, features.depth[i]);
+        for (size_t i = 0; i < size && aov == AOV_SAMPLES; i++) max_samples = std::max(max_samples, features.samples[i]);
+
+        // The cost is scaled to the 99th percentile so a handful of very slow pixels don't turn the rest dark.
+        double max_cost = 1.0;
+
+        if (aov == AOV_COST)
+        {
+            std::vector<uint64_t> sorted_cost = features.cost;
+            size_t percentile = (size_t)((size - 1) * 0.99);
+            std::nth_element(sorted_cost.begin(), sorted_cost.begin() + percentile, sorted_cost.end());
+            max_cost = std::max(1.0, (double)sorted_cost[percentile]);
+
+            PRINT("Cost heatmap: red is " << (uint64_t)max_cost << " cycles per pixel or more.");
+        }
+
+        for (size_t i = 0; i < size; i++)
+        {
+            switch (aov)
+            {
+            case AOV_ALBEDO: image[i] = features.albedo[i]; break;
+            case AOV_NORMAL: image[i] = Color(features.normal[i] * 0.5 + Vector3d::Constant(features.normal[i].isZero() ? 0.0 : 0.5)); break;
+            case AOV_DEPTH: image[i] = features.depth[i] < 0.0 ? Color::Black() : Color((float)(1.0 - features.depth[i] / max_depth)); break; // Near is bright
+            case AOV_PRIMITIVE_ID: image[i] = features.primitive_id[i] < 0 ? Color::Black() : IdColor((unsigned int)features.primitive_id[i], features.instance_id[i]); break;
+            case AOV_DIRECT: image[i] = features.direct[i]; break;
+            case AOV_INDIRECT: image[i] = features.indirect[i]; break;
+            case AOV_SAMPLES: image[i] = Color((float)features.samples[i] / max_samples); break;
+            case AOV_COST: image[i] = HeatmapColor(features.cost[i] / max_cost); break;
+            }
+        }
+
+        std::string file_name = base_name + "." + AOVName(aov) + ".ppm";
+
+        PRINT("Saving AOV as " + file_name + ".");
+        WritePPM(file_name, image);
+    }
+}
+
+void RayTracer::SaveStatistics(const Output& output, const Statistics::Report& report)
+{
+    std::string file_name = SideCarBaseName(output) + ".stats.json";
+
+    report.Print();
+    PRINT("Saving statistics as " + file_name + ".");
+
+    std::ofstream ofs(OutputPath(file_name));
+    ofs << report.ToJSON() << std::endl;
+}
+
+// Side-car files are named after the output, "image.ppm" gives "image.albedo.ppm" and so on.
+std::string RayTracer::SideCarBaseName(const Output& output)
+{
+    std::string base_name = output.GetFileName();
+    size_t extension = base_name.rfind('.');
+    if (extension != std::string::npos) base_name = base_name.substr(0, extension);
+
+    return base_name;
+}
+
+std::string RayTracer::OutputPath(const std::string& file_name)
+{
+#if STUDENT_SOLUTION || COURSE_SOLUTION
+    return file_name;
+#else
+    return ".\\outputs\\" + file_name;
+#endif
+}
+
+void RayTracer::WritePPM(const std::string& file_name, const std::vector<Color>& buffer)
+{
+    Camera& camera = Camera::GetInstance();
+
+    std::ofstream ofs(OutputPath(file_name), std::ios_base::out | std::ios_base::binary);
+
+    ofs << "P6" << std::endl << camera.Width() << ' ' << camera.Height() << std::endl << "255" << std::endl;
+
+    size_t size = buffer.size();
+
+    for (size_t i = 0; i < size; i++) {
+
+        Color color = buffer[i];
+        color = color.Clamp();
+        ofs << (unsigned char)(255.0f * color.r) << (unsigned char)(255.0f * color.g) << (unsigned char)(255.0f * color.b);
+    }
+
+    ofs.close();
+}
+
+// False colour ramp from black through blue, cyan, green and yellow to red as t goes from 0 to 1.
+Color RayTracer::HeatmapColor(double t)
+{
+    static const Color ramp[] = { Color::Black(), Color::Blue(), Color(0, 1, 1), Color::Green(), Color(1, 1, 0), Color::Red() };
+    static const int last = sizeof(ramp) / sizeof(ramp[0]) - 1;
+
+    double position = YuMath::Clamp(t, 0.0, 1.0) * last;
+    int index = std::min((int)position, last - 1);
+    double weight = position - index;
+
+    return ramp[index] * (1.0 - weight) + ramp[index + 1] * weight;
+}
+
+// Spreads consecutive ids over very different hues.
+// The first instance keeps the colours of a scene without instances, the others are mixed in.
+Color RayTracer::IdColor(unsigned int id, unsigned int instance)
+{
+    unsigned int hash = ((id + 1) * 2654435761u) ^ (instance * 2246822519u);
+
+    return Color((hash & 0xFF) / 255.0f, ((hash >> 8) & 0xFF) / 255.0f, ((hash >> 16) & 0xFF) / 255.0f);
+}
+
+#pragma endregion
+
+#pragma region Raytracer Core
+
+// Walks the top level BVH down to the instances the ray crosses, then the BVH of their group in the group's space.
+// on_hit(hit, distance, max_distance) is called for every intersection closer than max_distance, it may lower
+// max_distance to cull the rest and returns true to stop the walk.
+template <typename OnHit>
+void RayTracer::TraverseScene(const Ray& ray, double max_distance, OnHit on_hit)
+{
+    const double direction_length = ray.GetDirection().norm();
+    double max_t = max_distance / direction_length;
+    bool stop = false;
+
+    scene.GetTopLevel().Traverse(ray.GetOrigin(), ray.GetDirection(), max_t, [&](uint32_t instance_index)
+    {
+        const Instance& instance = scene.GetInstances().begin()[instance_index];
+        const GeometryGroup& group = instance.GetGroup();
+        Ray transformed;
+        const Ray& local = instance.IsIdentity() ? ray : (transformed = instance.ToLocal(ray));
+
+        group.bvh.Traverse(local.GetOrigin(), local.GetDirection(), max_t, [&](uint32_t item)
+        {
+            Geometry* geo = group.geometries[item];
+
+            STAT_COUNT(IntersectionTests);
+
+            bool hit = false;
+            Vector3d intersect;
+
+            if (geo->GetType() == GeometryType::Rectangle)
+            {
+                hit = IntersectCoor(local, *((Rectangle*)geo), intersect);
+            }
+            else if (geo->GetType() == GeometryType::Sphere)
+            {
+                hit = IntersectCoor(local, *((Sphere*)geo), intersect);
+            }
+
+            if (!hit) return false;
+
+            Hit found{ instance.IsIdentity() ? intersect : instance.PointToWorld(intersect), geo, intersect, &instance, instance_index };
+            double distance = ray.GetDistance(found.point);
+
+            if (!(distance < max_distance)) return false;
+
+            stop = on_hit(found, distance, max_distance);
+            max_t = max_distance / direction_length;
+
+            return stop;
+        });
+
+        return stop;
+    });
+}
+
+bool RayTracer::Raycast(Ray& ray, double max_distance)
+{
+    Hit closest{};
+    double closest_distance = DBL_MAX;
+
+    // Every hit lowers the distance, so farther boxes are skipped.
+    TraverseScene(ray, max_distance, [&](const Hit& hit, double distance, double& out_max_distance)
+    {
+        closest = hit;
+        closest_distance = distance;
+        out_max_distance = distance;
+
+        return false;
+    });
+
+    if (closest.obj == nullptr) return false;
+
+    ray.SetClosestHit(MakeHitRecord(closest, closest_distance));
+
+    return true;
+}
+
+// Only the closest hit gets its normal and surface coordinates, the other candidates never need them.
+HitRecord RayTracer::MakeHitRecord(const Hit& found, double distance)
+{
+    const Geometry& geo = *found.obj;
+    const Vector3d& point = found.local_point;
+
+    HitRecord hit;
+    hit.position = found.point;
+    hit.distance = distance;
+    hit.primitive_id = geo.GetId();
+    hit.instance_id = found.instance_id;
+    hit.material = geo.GetMaterial();
+
+    if (geo.GetType() == GeometryType::Sphere)
+    {
+        const Sphere& sphere = (const Sphere&)geo;
+        hit.normal = (point - sphere.GetCenter()).normalized();
+
+        hit.u = 0.5 + std::atan2(hit.normal.z(), hit.normal.x()) / (2.0 * PI);
+        hit.v = 0.5 - std::asin(YuMath::Clamp(hit.normal.y(), -1.0, 1.0)) / PI;
+    }
+    else if (geo.GetType() == GeometryType::Rectangle)
+    {
+        const Rectangle& rect = (const Rectangle&)geo;
+        hit.normal = rect.GetNormal();
+
+        Vector3d edge_u = rect.GetP2() - rect.GetP1();
+        Vector3d edge_v = rect.GetP4() - rect.GetP1();
+
+        hit.u = (point - rect.GetP1()).dot(edge_u) / edge_u.squaredNorm();
+        hit.v = (point - rect.GetP1()).dot(edge_v) / edge_v.squaredNorm();
+    }
+
+    if (!found.instance->IsIdentity()) hit.normal = found.instance->NormalToWorld(hit.normal);
+
+    return hit;
+}
+
+// Shoot a ray in the scene to find all objects that intersects it.
+std::vector<Hit> RayTracer::RaycastAll(const Ray& ray, double max_distance = DBL_MAX)
+{
+    std::vector<Hit> hits;
+
+    TraverseScene(ray, max_distance, [&](const Hit& hit, double, double&)
+    {
+        hits.push_back(hit);
+
+        return false;
+    });
+
+    return hits;
+}
+
+///          SPHERE            ///
+bool RayTracer::IntersectCoor(const Ray& ray, Sphere& sphere, Vector3d& intersect)
+{
+
+    double a, b, c;
+
+    Vector3d distance = ray.GetOrigin() - sphere.GetCenter();
+    a = ray.GetDirection().dot(ray.GetDirection());
+    b = 2.0f * ray.GetDirection().dot(distance);
+    c = distance.dot(distance) - sphere.GetRadius() * sphere.GetRadius();
+
+    double disc = YuMath::Discriminant(a, b, c);
+    if (disc < 0) return false; // Imaginary numbers
+
+    auto t = YuMath::Quadratic(a, b, c, disc);
+
+    // Saves the closest sphere hit point in front of the ray, b_neg is always the nearest root.
+    if (t->b_neg > RAY_EPSILON) intersect = (ray.GetPoint(t->b_neg));
+    else if (t->b_pos > RAY_EPSILON) intersect = (ray.GetPoint(t->b_pos)); // Ray starts inside or on the sphere
+    else return false; // Sphere is behind the ray
+
+    return true;
+}
+
+
+/// RECTANGLE
+bool RayTracer::IntersectCoor(const Ray& ray, Rectangle& rect, Vector3d& intersect)
+{
+    auto vn = ray.GetDirection().dot(rect.GetNormal());
+
+    if (vn == 0) return false; // Checks if ray is parallele to plane, if parallele return false
+
+    auto t = (rect.GetP1() - ray.GetOrigin()).dot(rect.GetNormal()) / vn;
+
+    if (t <= RAY_EPSILON) return false; // Plane is behind the ray or at its origin
+
+    auto hit_point = ray.GetPoint(t);
+
+    // Area Triangle Implementation
+    long double area1 = YuMath::TriangleArea(hit_point, rect.GetP1(), rect.GetP2());
+    long double area2 = YuMath::TriangleArea(hit_point, rect.GetP2(), rect.GetP3());
+    long double area3 = YuMath::TriangleArea(hit_point, rect.GetP3(), rect.GetP4());
+    long double area4 = YuMath::TriangleArea(hit_point, rect.GetP4(), rect.GetP1());
+
+    auto area_delta = rect.GetArea() - area1 - area2 - area3 - area4;
+
+    if (!(std::abs(area_delta) < 0.05f)) return false;// 0.05f is for truncation errors.
+
+    // To get this formula, first find formula for intersection between a plane and a line(ray)
+    // then to get your d = -(rect.GetP1().dot(rect.GetNormal())); // derived from "Scalar Form of the Equation of a Plane"
+    // finally, simplify it due to the cluster of negative sign and dot product. 
+
+    intersect = hit_point;
+
+    return true;
+}
+
+// DIRECT LIGHT
+
+ShadingPoint RayTracer::MakeShadingPoint(const Ray& ray)
+{
+    const HitRecord& hit = ray.GetHit();
+
+    return ShadingPoint{ hit, (Camera::GetInstance().Position() - hit.position).normalized(), MaterialOf(hit) };
+}
+
+template <bool AREA_LIGHTS>
+void RayTracer::ShadeDirect(const Ray& ray, Color* out_diffuse, Color* out_specular)
+{
+    const Material& material = MaterialOf(ray.GetHit());
+
+    // Walls and other matte surfaces would cast a shadow ray per light for a black specular, and the same goes for a
+    // material without diffuse.
+    if (out_diffuse != nullptr && !material.Has(MATERIAL_DIFFUSE))
+    {
+        STAT_COUNT(CulledLobes);
+        out_diffuse = nullptr;
+    }
+    if (out_specular != nullptr && !material.Has(MATERIAL_SPECULAR))
+    {
+        STAT_COUNT(CulledLobes);
+        out_specular = nullptr;
+    }
+    if (out_diffuse == nullptr && out_specular == nullptr) return;
+
+    ShadingPoint point = MakeShadingPoint(ray);
+
+    auto& lights = scene.GetLights();
+
+    for (auto& light : lights)
+    {
+        STAT_SET_LIGHT(&light - &lights[0]);
+
+        Vector3d light_center;
+
+        if (light->GetType().compare(POINT_LIGHT) == 0)
+        {
+            light_center = ((PointLight*)light)->GetCenter();
+        }
+        else if (light->GetType().compare(AREA_LIGHT) == 0)
+        {
+            AreaLight& area = *(AreaLight*)light;
+
+            if constexpr (AREA_LIGHTS)
+            {
+                if (!area.GetUseCenter())
+                {
+                    SampleAreaLight(area, point, ray, out_diffuse, out_specular);
+                    continue;
+                }
+            }
+
+            light_center = area.GetCenter();
+        }
+        else continue;
+
+        if (IsLightHidden(light_center, ray)) continue;
+
+        Vector3d towards_light = (light_center - point.hit.position).normalized();
+
+        if (out_diffuse != nullptr) *out_diffuse += EvaluateLobe(point, towards_light, *light, Lobe::Diffuse);
+        if (out_specular != nullptr) *out_specular += EvaluateLobe(point, towards_light, *light, Lobe::Specular);
+    }
+}
+
+// SPECULAR
+
+Color RayTracer::GetSpecularColor(const Ray& ray)
+{
+    Color specular;
+    ShadeDirect(ray, nullptr, &specular);
+
+    return specular;
+}
+
+double RayTracer::BlinnPhong(const Vector3d& normal, const Vector3d& towards_light, const Vector3d& towards_camera)
+{
+    return normal.dot((towards_light + towards_camera).normalized());
+}
+
+// DIFFUSE
+
+Color RayTracer::GetDiffuseColor(const Ray& ray, bool gl, unsigned int hit_count, Color* out_direct)
+{
+    Color diffuse;
+
+    // Only the paths need the per light walk below.
+    if (!gl)
+    {
+        ShadeDirect(ray, &diffuse, nullptr);
+
+        if (out_direct != nullptr) *out_direct += diffuse;
+        return diffuse;
+    }
+
+    auto& lights = scene.GetLights();
+
+    // Without a diffuse lobe there is no direct light to gather, only the bounces of the path can still bring light.
+    const bool has_diffuse = MaterialOf(ray.GetHit()).Has(MATERIAL_DIFFUSE);
+
+    for (auto& light : lights)
+    {
+        STAT_SET_LIGHT(&light - &lights[0]);
+
+        if (light->GetType().compare(POINT_LIGHT) == 0)
+        {
+            PointLight& point = *(PointLight*)light;
+
+            diffuse += CalculatePointLightDiffuse(point.GetCenter(), light->GetDiffuseIntensity(), ray, gl, hit_count, out_direct);
+        }
+        else if (light->GetType().compare(AREA_LIGHT) == 0)
+        {
+            AreaLight& area = *(AreaLight*)light;
+
+            if (area.GetUseCenter())
+            {
+                diffuse += CalculatePointLightDiffuse(area.GetCenter(), light->GetDiffuseIntensity(), ray, gl, hit_count, out_direct);
+            }
+            else if (has_diffuse)
+            {
+                Color area_diffuse;
+                SampleAreaLight(area, MakeShadingPoint(ray), ray, &area_diffuse, nullptr);
+
+                diffuse += area_diffuse;
+                if (out_direct != nullptr) *out_direct += area_diffuse;
+            }
+        }
+    }
+
+    return diffuse;
+}
+
+Color RayTracer::CalculatePointLightDiffuse(const Vector3d& light_center, const Color& light_diffuse_intensity, const Ray& ray, bool& gl, unsigned int hit_count, Color* out_direct)
+{
+    return Helper_CalculatePointLightDiffuse(light_center, light_diffuse_intensity, ray, hit_count, gl, out_direct);
+}
+
+Color RayTracer::Helper_CalculatePointLightDiffuse(const Vector3d& light_center, const Color& light_diffuse_intensity, const Ray& ray, unsigned int hit_count, bool& gl, Color* out_direct)
+{
+    const Vector3d& hit_normal = ray.GetHit().normal;
 
-    Hit& operator=(const Hit& hit)
-    {
-        point = hit.point;
-        obj = hit.obj;
+    Color direct;
 
-        return *this;
+    if (!MaterialOf(ray.GetHit()).Has(MATERIAL_DIFFUSE))
+    {
+        STAT_COUNT(CulledLobes);
     }
-};
+    else if (!IsLightHidden(light_center, ray))
+    {
+        Vector3d towards_light = (light_center - ray.GetHitCoor()).normalized();
 
-#pragma region Main Structure
+        double cos_angle = towards_light.dot(hit_normal);
 
-RayTracer::RayTracer(nlohmann::json json_file)
-    :json_file(json_file)
-{
-    PRINT("JSON file acquired!");
-}
+        if (cos_angle < 0.0f) cos_angle = 0.0f;
 
-RayTracer::~RayTracer() {}
+        direct = (MaterialOf(ray.GetHit()).diffuse * light_diffuse_intensity * cos_angle);
+    }
 
-void RayTracer::run()
-{
-    BuildScene();
+    if (out_direct != nullptr) *out_direct += direct;
 
-    for (Output* output : scene.GetOutputs())
+    if (!gl // Not using global illum
+        || hit_count >= Camera::GetInstance().MaxBounce())
     {
-        SetupCamera(*output);
-        Trace(*output);
-        SaveToPPM(*output);
+        return direct;
     }
-}
 
-/// Builds scene from json file
-void RayTracer::BuildScene()
-{
-    PRINT("Building scene...");
+    if (CustomRandom::GetInstance().Generate() <= Camera::GetInstance().ProbeTerminate())
+    {
+        STAT_COUNT(RussianRouletteKills);
+        return direct;
+    }
 
-    nlohmann::json geo = json_file.at("geometry");
-    nlohmann::json light = json_file.at("light");
-    nlohmann::json output = json_file.at("output");
+    // One bounce per vertex, the weight is only unbiased for the direction as sampled. A bounce that is absorbed or
+    // escapes the scene brings no indirect light, the direct light of this vertex still counts.
+    Vector3d bounce_dir;
+    Color bounce_weight;
 
-    JSONReadGeometries(scene.GetGeometries(), geo);
-    JSONReadLights(scene.GetLights(), light);
-    JSONReadOutput(scene.GetOutputs(), output);
+    if (!SampleBSDF(ray, hit_normal, bounce_dir, bounce_weight))
+    {
+        STAT_COUNT(InvalidGISamples);
+        return direct;
+    }
 
-    //#if _DEBUG
-    //        scene->PrintGeometries();
-    //        scene->PrintLights();
-    //        scene->PrintOutput();
-    //#endif
-}
+    Ray next_ray(ray.GetHitCoor(), bounce_dir);
 
-void RayTracer::SetupCamera(const Output& output)
-{
-    PRINT("Setting up the camera...");
-    Camera::GetInstance().SetData(output, RESOLUTION);
+    STAT_COUNT(IndirectRays);
+    STAT_PATH_RAY(hit_count + 1);
+    if (!Raycast(next_ray)) return direct;
+
+    // Surviving paths carry the energy of the ones killed by russian roulette.
+    return Color::MulAdd(bounce_weight, Helper_CalculatePointLightDiffuse(light_center, light_diffuse_intensity, next_ray, hit_count + 1, gl) / (1.0f - Camera::GetInstance().ProbeTerminate()), direct);
 }
 
-void RayTracer::Trace(const Output& output)
+bool RayTracer::SampleBSDF(const Ray& ray, const Vector3d& hit_normal, Vector3d& out_dir, Color& out_weight)
 {
-    PRINT("Tracing...");
-
-    Camera& camera = Camera::GetInstance();
+    const Material& material = MaterialOf(ray.GetHit());
 
-    auto& output_buffer = camera.GetOutputBuffer();
-
-    size_t buffer_size = output_buffer.size();
+    double diffuse_weight = material.diffuse.Average();
+    double specular_weight = material.specular.Average();
 
-    Vector3d px, py;
+    if (diffuse_weight + specular_weight <= 0.0) return false; // Absorbs everything
 
-    uint32_t counter = 0;
+    // Picks a lobe in proportion to how much light it reflects.
+    double diffuse_prob = diffuse_weight / (diffuse_weight + specular_weight);
+    double exponent = material.phong;
 
-    bool use_AA = (output.HasGlobalIllumination() || output.AntiAliase()) && !scene.HasAreaLight(); // If scene has GL or AreaL then no AA 
-    bool use_specular = !output.HasGlobalIllumination(); // If scene has GL then no specular light
-
-    // For each height, trace its row
-    for (uint32_t y = 0; y < camera.Height(); y++)
-    {
-        //std::cout << std::endl;
-        for (uint32_t x = 0; x < camera.Width(); x++)
-        {
-            Color final_ambient;
-            Color final_diffuse;
-            Color final_specular;
+    Vector3d towards_camera = -ray.GetDirection().normalized();
+    double pdf;
 
-            px = (camera.ScaledPixel() - (2.0f * x + 1.0f) * camera.PixelCenter()) * camera.Right(); //(2.0f * y + 1.0f) == 2k + 1 aka odd number
-            py = (camera.HalfImage() - (2.0f * y + 1.0f) * camera.PixelCenter()) * camera.Up(); //(2.0f * y + 1.0f) == 2k + 1 aka odd number
+    if (CustomRandom::GetInstance().Generate() < diffuse_prob) out_dir = YuMath::CosineSampleHemisphere(hit_normal, pdf);
+    else out_dir = YuMath::SampleBlinnPhong(hit_normal, towards_camera, exponent, pdf);
 
-            Vector3d pixel_shoot_at = camera.OriginLookAt() + px + py;
+    double cos_angle = hit_normal.dot(out_dir);
 
-            Ray ray = camera.MakeRay(pixel_shoot_at);
-            bool hit = Raycast(ray);
+    if (cos_angle <= 0.0) return false; // Sampled below the surface
 
-            if (use_AA)
-            {
-                UseMSAA(px, py, final_ambient, final_diffuse, output, output.HasGlobalIllumination());
-            }
-            else // No AA
-            {
-                if (hit)
-                {
-                    final_diffuse = GetDiffuseColor(ray, false);
-                    final_ambient = GetAmbientColor(ray);
-                }
-                else
-                {
-                    final_ambient = output.GetBgColor();
-                }
-            }
+    // One sample of the lobe mixture has to be divided by the pdf of the whole mixture.
+    pdf = diffuse_prob * YuMath::CosineHemispherePdf(hit_normal, out_dir)
+        + (1.0 - diffuse_prob) * YuMath::BlinnPhongPdf(hit_normal, towards_camera, out_dir, exponent);
 
-            if (hit && use_specular) final_specular = GetSpecularColor(ray);
+    if (pdf <= 0.0) return false;
 
+    // Lambert plus energy normalized Blinn-Phong.
+    double cos_half = std::max(0.0, BlinnPhong(hit_normal, out_dir, towards_camera));
+    Color bsdf = Color::MulAdd(material.specular, (exponent + 8.0) / (8.0 * PI) * std::pow(cos_half, exponent), material.diffuse * (1.0f / PI));
 
-            output_buffer[counter] = (final_ambient * camera.AmbientIntensity() + final_diffuse + final_specular).Clamp();
+    out_weight = bsdf * (cos_angle / pdf);
 
-            counter++;
-        }
-    }
+    return true;
 }
 
-void RayTracer::SaveToPPM(const Output& output)
-{
-    Camera& camera = Camera::GetInstance();
-
-    PRINT("Saving output as " + output.GetFileName() + ".");
 
-#if STUDENT_SOLUTION || COURSE_SOLUTION
-    std::ofstream ofs(output.GetFileName(), std::ios_base::out | std::ios_base::binary);
-#else
-    std::ofstream ofs(".\\outputs\\" + output.GetFileName(), std::ios_base::out | std::ios_base::binary);
-#endif
+// AREA LIGHT
 
-    ofs << "P6" << std::endl << camera.Width() << ' ' << camera.Height() << std::endl << "255" << std::endl;
+Color RayTracer::EvaluateLobe(const ShadingPoint& point, const Vector3d& towards_light, const Light& light, Lobe lobe)
+{
+    const Material& material = point.material;
 
-    auto& buffer = camera.GetOutputBuffer();
-    size_t size = buffer.size();
+    if (lobe == Lobe::Diffuse)
+    {
+        double cos_angle = towards_light.dot(point.hit.normal);
 
-    for (uint32_t i = 0; i < size; i++) {
+        if (cos_angle < 0.0f) cos_angle = 0.0f;
 
-        ofs << (char)(255.0f * buffer[i].r) << (char)(255.0f * buffer[i].g) << (char)(255.0f * buffer[i].b);
+        return material.diffuse * light.GetDiffuseIntensity() * cos_angle;
     }
 
-    ofs.close();
+    //Phong
+    //Vector3d reflect = YuMath::Reflect(hit_normal, towards_light);
+    //double cos_angle = towards_camera.dot(reflect) / (towards_camera.norm() * reflect.norm());
 
-    PRINT("Done saving!");
-}
+    //Blinn-Phong
+    double cos_angle = BlinnPhong(point.hit.normal, towards_light, point.towards_camera);
 
-#pragma endregion
+    if (cos_angle < 0.0f) return Color::Black();
 
-#pragma region Raytracer Core
+    return light.GetSpecularIntensity() * material.specular * std::pow(cos_angle, material.phong);
+}
 
-bool RayTracer::Raycast(Ray& ray, double max_distance)
+double RayTracer::LobePdf(const ShadingPoint& point, const Vector3d& towards_light, Lobe lobe)
 {
-    auto hits = RaycastAll(ray, max_distance);
+    if (lobe == Lobe::Diffuse) return YuMath::CosineHemispherePdf(point.hit.normal, towards_light);
 
-    if (hits.empty()) return false;
-
-    // Find the nearest obj
-    for (auto& hit : hits)
-    {
-        if (ray.IsCloser(hit.point))
-        {
-            ray.SetClosestHit(hit.point, *hit.obj);
-        }
-    }
+    if (point.hit.normal.dot(towards_light) <= 0.0) return 0.0;
 
-    return true;
+    return YuMath::BlinnPhongPdf(point.hit.normal, point.towards_camera, towards_light, point.material.phong);
 }
 
-// Shoot a ray in the scene to find all objects that intersects it.
-std::vector<Hit> RayTracer::RaycastAll(const Ray& ray, double max_distance = DBL_MAX)
+// Direct light of an area light, combining n * n stratified light samples and n * n lobe samples with the power heuristic.
+// Every point of the light shines like a point light of the same intensity (no falloff), so seen from the hit point
+// the light has radiance I * d^2 / (A * cos_light) and the light sample estimate reduces to the lobe value.
+// The light samples and their shadow rays are shared by the lobes, each lobe still draws its own lobe samples.
+void RayTracer::SampleAreaLight(AreaLight& area, const ShadingPoint& point, const Ray& ray, Color* out_diffuse, Color* out_specular)
 {
-    auto& geometries = scene.GetGeometries();
+    const unsigned int n = area.GetSampleCount();
+    const double area_size = area.GetArea();
 
-    std::vector<Hit> hits;
+    const Lobe lobes[2] = { Lobe::Diffuse, Lobe::Specular };
+    Color* out_lobes[2] = { out_diffuse, out_specular };
+    Color estimates[2];
 
-    for (Geometry* geo : geometries)
+    for (unsigned int i = 0; i < n; i++)
     {
-        bool hit = false;
+        for (unsigned int j = 0; j < n; j++)
+        {
+            // Light sampling, jittered inside each cell of the light's grid.
+            Vector3d light_point = area.GetPoint((i + CustomRandom::GetInstance().Generate()) / n, (j + CustomRandom::GetInstance().Generate()) / n);
 
-        Vector3d intersect;
+            Vector3d towards_light = light_point - point.hit.position;
+            double distance_sqr = towards_light.squaredNorm();
+            towards_light.normalize();
 
-        if (geo->GetType().compare(RECTANGLE) == 0)
-        {
-            hit = IntersectCoor(ray, *((Rectangle*)geo), intersect);
-        }
-        else if (geo->GetType().compare(SPHERE) == 0)
-        {
-            hit = IntersectCoor(ray, *((Sphere*)geo), intersect);
-        }
+            double cos_light = std::abs(area.GetNormal().dot(towards_light));
 
-        if (hit && ray.GetDistance(intersect) < max_distance)
-        {
-            hits.push_back(Hit{ intersect, geo });
-        }
-    }
+            if (cos_light > 0.0 && !IsLightHidden(light_point, ray))
+            {
+                double light_pdf = distance_sqr / (area_size * cos_light);
 
-    return hits;
-}
+                for (int l = 0; l < 2; l++)
+                {
+                    if (out_lobes[l] == nullptr) continue;
 
-///          SPHERE            ///
-bool RayTracer::IntersectCoor(const Ray& ray, Sphere& sphere, Vector3d& intersect)
-{
+                    double lobe_pdf = LobePdf(point, towards_light, lobes[l]);
 
-    double a, b, c;
+                    estimates[l].AddMul(EvaluateLobe(point, towards_light, area, lobes[l]), YuMath::PowerHeuristic(light_pdf, lobe_pdf));
+                }
+            }
 
-    Vector3d distance = ray.GetOrigin() - sphere.GetCenter();
-    a = ray.GetDirection().dot(ray.GetDirection());
-    b = 2.0f * ray.GetDirection().dot(distance);
-    c = distance.dot(distance) - sphere.GetRadius() * sphere.GetRadius();
+            // Lobe sampling, only counts when the sampled direction reaches the light.
+            for (int l = 0; l < 2; l++)
+            {
+                if (out_lobes[l] == nullptr) continue;
 
-    double disc = YuMath::Discriminant(a, b, c);
-    if (disc < 0) return false; // Imaginary numbers
+                double lobe_pdf;
 
-    auto t = YuMath::Quadratic(a, b, c, disc);
+                if (lobes[l] == Lobe::Diffuse) towards_light = YuMath::CosineSampleHemisphere(point.hit.normal, lobe_pdf);
+                else towards_light = YuMath::SampleBlinnPhong(point.hit.normal, point.towards_camera, point.material.phong, lobe_pdf);
 
-    double b_pos_length = (ray.GetPoint(t->b_pos) - ray.GetOrigin()).norm();
-    double b_neg_length = (ray.GetPoint(t->b_neg) - ray.GetOrigin()).norm();
+                if (lobe_pdf <= 0.0 || point.hit.normal.dot(towards_light) <= 0.0) continue;
 
-    // Saves the closest sphere hit point.
-    if (b_pos_length < b_neg_length) intersect = (ray.GetPoint(t->b_pos)); // point at b_pos is closer
-    else intersect = (ray.GetPoint(t->b_neg)); // point at b_neg is closer
+                Ray ray_towards_light(point.hit.position, towards_light);
 
-    return true;
-}
+                if (!IntersectCoor(ray_towards_light, area.GetRectangle(), light_point)) continue;
 
+                distance_sqr = (light_point - point.hit.position).squaredNorm();
+                cos_light = std::abs(area.GetNormal().dot(towards_light));
 
-/// RECTANGLE
-bool RayTracer::IntersectCoor(const Ray& ray, Rectangle& rect, Vector3d& intersect)
-{
-    auto vn = ray.GetDirection().dot(rect.GetNormal());
+                if (cos_light <= 0.0 || IsLightHidden(light_point, ray)) continue;
 
-    if (vn == 0) return false; // Checks if ray is parallele to plane, if parallele return false
+                double light_pdf = distance_sqr / (area_size * cos_light);
 
-    auto t = (rect.GetP1() - ray.GetOrigin()).dot(rect.GetNormal()) / vn;
+                estimates[l].AddMul(EvaluateLobe(point, towards_light, area, lobes[l]), YuMath::PowerHeuristic(lobe_pdf, light_pdf) * light_pdf / lobe_pdf);
+            }
+        }
+    }
 
-    if (t == 0) return false;
+    for (int l = 0; l < 2; l++)
+    {
+        if (out_lobes[l] != nullptr) *out_lobes[l] += estimates[l] / (double)(n * n);
+    }
+}
 
-    auto hit_point = ray.GetPoint(t);
 
-    // Area Triangle Implementation
-    long double area1 = YuMath::TriangleArea(hit_point, rect.GetP1(), rect.GetP2());
-    long double area2 = YuMath::TriangleArea(hit_point, rect.GetP2(), rect.GetP3());
-    long double area3 = YuMath::TriangleArea(hit_point, rect.GetP3(), rect.GetP4());
-    long double area4 = YuMath::TriangleArea(hit_point, rect.GetP4(), rect.GetP1());
+// IRRADIANCE CACHE
 
-    auto area_delta = rect.GetArea() - area1 - area2 - area3 - area4;
+// Only purely diffuse surfaces take their indirect light from the cache or the photon map, glossy ones keep tracing paths.
+bool RayTracer::IsPurelyDiffuse(const HitRecord& hit)
+{
+    return MaterialOf(hit).IsPurelyDiffuse();
+}
 
-    if (!(std::abs(area_delta) < 0.05f)) return false;// 0.05f is for truncation errors.
+Color RayTracer::GetIndirectDiffuse(const Ray& ray, const Output& output)
+{
+    const Color& albedo = MaterialOf(ray.GetHit()).diffuse;
 
-    // To get this formula, first find formula for intersection between a plane and a line(ray)
-    // then to get your d = -(rect.GetP1().dot(rect.GetNormal())); // derived from "Scalar Form of the Equation of a Plane"
-    // finally, simplify it due to the cluster of negative sign and dot product. 
+    if (albedo.Average() <= 0.0f) return Color::Black();
 
-    intersect = hit_point;
+    const Vector3d& hit_normal = ray.GetHit().normal;
+    Color irradiance;
 
-    return true;
-}
+    if (!irradiance_cache.Lookup(ray.GetHitCoor(), hit_normal, irradiance))
+    {
+        IrradianceRecord record = ComputeIrradianceRecord(ray, hit_normal, output.GetCacheSamples());
 
-// SPECULAR
+        irradiance_cache.Insert(record);
+        irradiance = record.irradiance;
+    }
 
-Color RayTracer::GetSpecularColor(const Ray& ray)
+    return albedo * irradiance;
+}
+
+// Samples the hemisphere over stratified cos^2 theta rows and phi columns, then derives the rotation and
+// translation gradients of Ward & Heckbert from the same samples (as written in Jarosz et al.).
+IrradianceRecord RayTracer::ComputeIrradianceRecord(const Ray& ray, const Vector3d& hit_normal, unsigned int samples)
 {
-    //Keep for ref
-    //auto adjacent = normal * incoming.dot(normal);
-    //auto opposite = incoming - adjacent;
-    //Vector3d reflect =  adjacent - opposite ;
+    const unsigned int rows = std::max(1u, (unsigned int)std::sqrt(samples / PI)); // About PI times more columns than rows
+    const unsigned int columns = std::max(1u, samples / rows);
+    const unsigned int count = rows * columns;
 
-    Vector3d towards_camera = (Camera::GetInstance().Position() - ray.GetHitCoor()).normalized();
-    Color specular;
+    YuMath::ONB onb(hit_normal);
 
-    Vector3d hit_normal = GetNormal(ray);
+    std::vector<Color> radiance(count);
+    std::vector<double> distance(count, INFINITY);
 
-    auto& lights = scene.GetLights();
+    IrradianceRecord record;
+    record.position = ray.GetHitCoor();
+    record.normal = hit_normal;
 
-    for (auto& light : lights)
+    for (int c = 0; c < 3; c++)
     {
-        if (light->GetType().compare(POINT_LIGHT) == 0)
+        record.rotation_gradient[c] = Vector3d::Zero();
+        record.translation_gradient[c] = Vector3d::Zero();
+    }
+
+    double inverse_distance_sum = 0.0;
+
+    for (unsigned int j = 0; j < rows; j++)
+    {
+        for (unsigned int k = 0; k < columns; k++)
         {
-            PointLight& point = *(PointLight*)light;
+            double sin_sqr = (j + CustomRandom::GetInstance().Generate()) / rows;
+            double sin_theta = std::sqrt(sin_sqr);
+            double cos_theta = std::sqrt(std::max(0.0, 1.0 - sin_sqr));
+            double phi = 2.0 * PI * (k + CustomRandom::GetInstance().Generate()) / columns;
+
+            Ray next_ray(ray.GetHitCoor(), onb.ToWorld(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta));
 
-            Vector3d towards_light = (point.GetCenter() - ray.GetHitCoor()).normalized();
+            Color incoming;
 
-            if (IsLightHidden(point.GetCenter(), ray))
+            STAT_COUNT(IndirectRays);
+            STAT_PATH_RAY(1);
+            if (Raycast(next_ray))
             {
-                specular += Color::Black();
-                continue;
+                incoming = GetDiffuseColor(next_ray, true, 1);
+
+                distance[j * columns + k] = next_ray.GetHitDistance();
+                inverse_distance_sum += 1.0 / next_ray.GetHitDistance();
             }
 
-            //Phong
-            //Vector3d reflect = Reflect(hit_normal, towards_light);
-            //double cos_angle = towards_camera.dot(reflect) / (towards_camera.norm() * reflect.norm());
+            radiance[j * columns + k] = incoming;
+            record.irradiance += incoming;
 
-            //Blinn-Phong
-            double cos_angle = BlinnPhong(hit_normal, towards_light, towards_camera);
+            if (cos_theta <= 0.0) continue;
 
-            if (cos_angle < 0.0f) continue;
+            Vector3d v = onb.ToWorld(-std::sin(phi), std::cos(phi), 0.0) * (-sin_theta / cos_theta);
 
-            specular += (light->GetSpecularIntensity() * ray.hit_obj->GetSpecularCoeff() * ray.hit_obj->GetSpecularColor() * std::pow(cos_angle, ray.hit_obj->GetPhongCoeff()));
+            record.rotation_gradient[0] += v * incoming.r;
+            record.rotation_gradient[1] += v * incoming.g;
+            record.rotation_gradient[2] += v * incoming.b;
         }
-        else if (light->GetType().compare(AREA_LIGHT) == 0)
-        {
-            AreaLight& area = *(AreaLight*)light;
-
-            auto& hit_points = area.GetHitPoints();
+    }
 
-            Color spec;
+    for (unsigned int k = 0; k < columns; k++)
+    {
+        double phi_center = 2.0 * PI * (k + 0.5) / columns;
+        double phi_minus = 2.0 * PI * k / columns;
 
-            for (Vector3d& point : hit_points)
-            {
-                Vector3d towards_light = (point - ray.GetHitCoor()).normalized();
+        Vector3d u = onb.ToWorld(std::cos(phi_center), std::sin(phi_center), 0.0);
+        Vector3d v = onb.ToWorld(-std::sin(phi_minus), std::cos(phi_minus), 0.0);
 
-                if (IsLightHidden(point, ray))
-                {
-                    specular += Color::Black();
-                    continue;
-                }
+        unsigned int previous_k = (k + columns - 1) % columns;
 
-                //Phong
-                //Vector3d reflect = YuMath::Reflect(hit_normal, towards_light);
-                //double cos_angle = towards_camera.dot(reflect) / (towards_camera.norm() * reflect.norm());
+        for (unsigned int j = 0; j < rows; j++)
+        {
+            unsigned int index = j * columns + k;
 
-                double cos_angle = BlinnPhong(hit_normal, towards_light, towards_camera);
+            double sin_minus = std::sqrt((double)j / rows);
+            double sin_plus = std::sqrt((double)(j + 1) / rows);
 
-                if (cos_angle < 0.0f) continue;
+            // Change across the boundary with the previous row.
+            if (j > 0)
+            {
+                unsigned int other = (j - 1) * columns + k;
+                double scale = 2.0 * PI / columns * sin_minus * (1.0 - sin_minus * sin_minus) / std::min(distance[index], distance[other]);
 
-                spec += (light->GetSpecularIntensity() * ray.hit_obj->GetSpecularCoeff() * ray.hit_obj->GetSpecularColor() * std::pow(cos_angle, ray.hit_obj->GetPhongCoeff()));
+                record.translation_gradient[0] += u * (scale * (radiance[index].r - radiance[other].r));
+                record.translation_gradient[1] += u * (scale * (radiance[index].g - radiance[other].g));
+                record.translation_gradient[2] += u * (scale * (radiance[index].b - radiance[other].b));
             }
 
-            specular = spec / (double)hit_points.size();
+            // Change across the boundary with the previous column.
+            unsigned int other = j * columns + previous_k;
+            double scale = (sin_plus - sin_minus) / std::min(distance[index], distance[other]);
+
+            record.translation_gradient[0] += v * (scale * (radiance[index].r - radiance[other].r));
+            record.translation_gradient[1] += v * (scale * (radiance[index].g - radiance[other].g));
+            record.translation_gradient[2] += v * (scale * (radiance[index].b - radiance[other].b));
         }
     }
 
-    return specular;
-}
+    // The formulas give E, the record keeps E / PI.
+    record.irradiance /= (double)count;
 
-inline double RayTracer::BlinnPhong(const Vector3d& normal, const Vector3d& towards_light, const Vector3d& towards_camera)
-{
-    return normal.dot((towards_light + towards_camera).normalized());
+    for (int c = 0; c < 3; c++)
+    {
+        record.rotation_gradient[c] /= (double)count;
+        record.translation_gradient[c] /= PI;
+    }
+
+    record.radius = inverse_distance_sum > 0.0 ? count / inverse_distance_sum : irradiance_cache.MaxRadius();
+
+    // Records with steep gradients shrink so the linear extrapolation stays sensible.
+    float channels[3] = { record.irradiance.r, record.irradiance.g, record.irradiance.b };
+
+    for (int c = 0; c < 3; c++)
+    {
+        double gradient = record.translation_gradient[c].norm();
+
+        if (gradient > 0.0 && channels[c] > 0.0f) record.radius = std::min(record.radius, channels[c] / gradient);
+    }
+
+    record.radius = YuMath::Clamp(record.radius, irradiance_cache.MinRadius(), irradiance_cache.MaxRadius());
+
+    return record;
 }
 
-// DIFFUSE
 
-Color RayTracer::GetDiffuseColor(const Ray& ray, bool gl = true)
+// PHOTON MAP
+
+void RayTracer::EmitPhotons(const Output& output)
 {
-    auto& lights = scene.GetLights();
+    TIMELINE_SCOPE("EmitPhotons");
 
-    Color diffuse;
+    photon_map.Clear();
 
-    for (auto& light : lights)
+    struct Batch
     {
-        if (light->GetType().compare(POINT_LIGHT) == 0)
-        {
-            PointLight& point = *(PointLight*)light;
+        Light* light;
+        unsigned int count;
+        unsigned int light_photons;
+    };
 
-            diffuse += CalculatePointLightDiffuse(point.GetCenter(), light->GetDiffuseIntensity(), ray, gl);
-        }
-        else if (light->GetType().compare(AREA_LIGHT) == 0)
-        {
-            AreaLight& area = *(AreaLight*)light;
+    // Photons are shared between the lights in proportion to their diffuse intensity.
+    double total_power = 0.0;
 
-            if (area.GetUseCenter())
-            {
-                diffuse += CalculatePointLightDiffuse(area.GetCenter(), light->GetDiffuseIntensity(), ray, gl);
-            }
-            else
-            {
-                auto& hit_points = area.GetHitPoints();
+    for (Light* light : scene.GetLights()) total_power += light->GetDiffuseIntensity().Average();
 
-                Color color;
+    if (total_power <= 0.0) return;
 
-                for (Vector3d& point : hit_points)
-                {
-                    color += CalculatePointLightDiffuse(point, light->GetDiffuseIntensity(), ray, gl);
-                }
+    std::vector<Batch> batches;
 
-                diffuse += (color / (double)hit_points.size());
-            }
+    for (Light* light : scene.GetLights())
+    {
+        unsigned int light_photons = (unsigned int)(output.GetPhotonCount() * light->GetDiffuseIntensity().Average() / total_power);
+
+        for (unsigned int start = 0; start < light_photons; start += PHOTON_BATCH)
+        {
+            batches.push_back(Batch{ light, std::min(PHOTON_BATCH, light_photons - start), light_photons });
         }
     }
 
-    return diffuse;
-}
+    Parallel::For(batches.size(), [&](size_t i)
+    {
+        TIMELINE_SCOPE("PhotonBatch", (int64_t)i);
+        STAT_PERF_SCOPE(Trace);
 
-Color RayTracer::CalculatePointLightDiffuse(const Vector3d& light_center, const Color& light_diffuse_intensity, const Ray& ray, bool& gl)
-{
-    return Helper_CalculatePointLightDiffuse(light_center, light_diffuse_intensity, ray, 0, gl);
+        std::vector<Photon> photons;
+
+        for (unsigned int photon = 0; photon < batches[i].count; photon++) TracePhoton(*batches[i].light, batches[i].light_photons, photons);
+
+        photon_map.Store(photons);
+    });
+
+    {
+        TIMELINE_SCOPE("BuildPhotonMap");
+        photon_map.Build();
+    }
+
+    PRINT("Photons stored: " << photon_map.Size() << ", radius: " << photon_radius);
 }
 
-Color RayTracer::Helper_CalculatePointLightDiffuse(const Vector3d& light_center, const Color& light_diffuse_intensity, const Ray& ray, unsigned int hit_count, bool& gl)
+void RayTracer::TracePhoton(Light& light, unsigned int light_photons, std::vector<Photon>& out_photons)
 {
-    Vector3d hit_normal = GetNormal(ray);
+    Vector3d origin;
 
-    if (!gl // Not using global illum
-        || hit_count >= Camera::GetInstance().MaxBounce()
-        || CustomRandom::GetInstance().Generate() <= Camera::GetInstance().ProbeTerminate())
+    if (light.GetType().compare(POINT_LIGHT) == 0)
     {
-        if (IsLightHidden(light_center, ray))
-        {
-            return Color::Black();
-        }
-        else
-        {
-            Vector3d towards_light = (light_center - ray.GetHitCoor()).normalized();
+        origin = ((PointLight&)light).GetCenter();
+    }
+    else if (light.GetType().compare(AREA_LIGHT) == 0)
+    {
+        AreaLight& area = (AreaLight&)light;
 
-            double cos_angle = towards_light.dot(hit_normal);
+        if (area.GetUseCenter()) origin = area.GetCenter();
+        else origin = area.GetPoint(CustomRandom::GetInstance().Generate(), CustomRandom::GetInstance().Generate());
+    }
+    else return;
 
-            if (cos_angle < 0.0f) cos_angle = 0.0f;
+    // Every light point shines evenly all around like in the direct lighting.
+    Ray ray(origin, YuMath::UniformSampleSphere());
 
-            Geometry* geo = ray.hit_obj;
-            return (geo->GetDiffuseColor() * geo->GetDiffuseCoeff() * light_diffuse_intensity * cos_angle);
-        }
-    }
+    STAT_COUNT(IndirectRays);
+    if (!Raycast(ray)) return;
 
+    // Lights have no falloff in this tracer, scaling by the squared distance keeps the first photon density at I * cos,
+    // the same irradiance the direct light gives. Every later bounce is transported as is.
+    double distance = ray.GetHitDistance();
+    Color power = light.GetDiffuseIntensity() * (4.0 * PI * distance * distance / light_photons);
 
-    //// Find next bounce (Try again)
-    for (size_t i = 0; i < 3; i++) 
+    for (unsigned int bounce = 1; bounce <= Camera::GetInstance().MaxBounce(); bounce++)
     {
-        Ray next_ray(ray.GetHitCoor(), YuMath::RandomDir(hit_normal));
+        Vector3d bounce_dir;
+        Color bounce_weight;
 
-        if (Raycast(next_ray))
-        {
-            Geometry* geo = ray.hit_obj;
+        if (!SampleBSDF(ray, ray.GetHit().normal, bounce_dir, bounce_weight)) return;
+
+        // Russian roulette keeps the photon powers close to each other.
+        double survive = std::min(1.0, (double)bounce_weight.Average());
+
+        if (CustomRandom::GetInstance().Generate() >= survive) return;
+
+        power = power * bounce_weight / survive;
 
-            Color color = (geo->GetDiffuseColor() * geo->GetDiffuseCoeff() * light_diffuse_intensity);
+        Ray next_ray(ray.GetHitCoor(), bounce_dir);
 
-            return color * (1.0f / (2.0f * PI)) + Helper_CalculatePointLightDiffuse(light_center, light_diffuse_intensity, next_ray, hit_count + 1, gl);
+        STAT_COUNT(IndirectRays);
+        if (!Raycast(next_ray)) return;
+
+        ray = next_ray;
+
+        // Only indirect light is stored, the direct light keeps coming from the lights.
+        if (MaterialOf(ray.GetHit()).Has(MATERIAL_DIFFUSE))
+        {
+            out_photons.push_back(Photon{ ray.GetHitCoor(), bounce_dir, power });
         }
     }
-    
-    valid = false;
-    return Color::Black(); // If all else fails return black.
+}
+
+Color RayTracer::GetPhotonIndirect(const Ray& ray)
+{
+    const Color& albedo = MaterialOf(ray.GetHit()).diffuse;
+
+    if (albedo.Average() <= 0.0f) return Color::Black();
+
+    STAT_COUNT(PhotonGathers);
+    Color power = photon_map.Gather(ray.GetHitCoor(), ray.GetHit().normal, photon_radius);
+
+    return albedo * power / (PI * photon_radius * photon_radius);
 }
 
 
@@ -457,31 +1438,34 @@ bool RayTracer::IsLightHidden(const Vector3d& light_center, const Ray& ray)
 
     Ray ray_towards_light(ray.GetHitCoor(), towards_light);
 
-    auto hits = RaycastAll(ray_towards_light, towards_light_distance);
-    std::vector<Hit> filtered_hits;
+    STAT_COUNT(ShadowRays);
+
+    bool hidden = false;
 
-    // Filter out objects that are not in between light & hit
-    for (Hit& hit : hits)
+    // Any object in between is enough, the walk stops at the first one.
+    TraverseScene(ray_towards_light, towards_light_distance, [&](const Hit& hit, double, double&)
     {
         double to_light_dist = (hit.point - light_center).norm();
         double to_hit_coor_dist = (hit.point - ray.GetHitCoor()).norm();
 
-        if (to_light_dist > 0.001f  // Object is embedded in light
+        hidden = to_light_dist > 0.001f  // Object is embedded in light
             && to_hit_coor_dist > 0.001f // Object is hit coordinate
-            && to_light_dist <= towards_light_distance) // object is behind hit coor
-        {
-            filtered_hits.push_back(hit);
-        }
-    }
+            && to_light_dist <= towards_light_distance; // object is behind hit coor
 
-    if (filtered_hits.size() > 0) return true;
+        return hidden;
+    });
 
-    return false;
+    return hidden;
 }
 
 
-void RayTracer::UseMSAA(const Vector3d& px, const Vector3d& py, Color& out_final_ambient, Color& out_final_diffuse, const Output& output, const bool& gl)
+template <bool GI>
+void RayTracer::UseMSAA(const Vector3d& px, const Vector3d& py, Color& out_final_ambient, Color& out_final_diffuse, Color& out_final_indirect, unsigned int& out_sample_count, const Output& output)
 {
+    // Decided once per pixel instead of once per sample.
+    const bool use_photon_map = GI && output.UsePhotonMap();
+    const bool use_irradiance_cache = GI && output.UseIrradianceCache();
+
     const uint16_t grid_height = Camera::GetInstance().GridHeight();
     const uint16_t grid_width = Camera::GetInstance().GridWidth();
 
@@ -489,16 +1473,17 @@ void RayTracer::UseMSAA(const Vector3d& px, const Vector3d& py, Color& out_final
     const double sample_size = Camera::GetInstance().SampleSize();
 
     const double subpixel_center = Camera::GetInstance().PixelCenter() / (grid_height); // Why height, cause it is the "a" value
-    const unsigned int grid_cell_count = grid_height * grid_width;
 
     const double subpixel_size = subpixel_center + subpixel_center;
 
+    unsigned int valid_cells = 0;
+
     //Scanline for each row -> column
     for (uint32_t grid_y = 0; grid_y < grid_width; grid_y++)
     {
         for (uint32_t grid_x = 0; grid_x < grid_height; grid_x++) // Samples area color around the current pixel
         {
-            Color diffuse, ambient;
+            Color diffuse, ambient, indirect;
             unsigned int invalid_samples = 0;
 
             for (uint16_t sample = 0; sample < sample_size; sample++)
@@ -508,48 +1493,76 @@ void RayTracer::UseMSAA(const Vector3d& px, const Vector3d& py, Color& out_final
                 Vector3d subpixel_shoot_at = Camera::GetInstance().OriginLookAt() + sub_px + sub_py;
 
                 Ray ray = Camera::GetInstance().MakeRay(subpixel_shoot_at);
-                
-                valid = true;
 
+                STAT_COUNT(PrimaryRays);
+                STAT_PATH_RAY(0);
                 if (Raycast(ray))
                 {
-                    ambient += GetAmbientColor(ray) * Camera::GetInstance().AmbientIntensity();
-
-                    diffuse += GetDiffuseColor(ray, gl);
-
-                    if (!valid) invalid_samples++;
+                    if (use_photon_map && IsPurelyDiffuse(ray.GetHit()))
+                    {
+                        Color indirect_sample = GetPhotonIndirect(ray);
+
+                        diffuse += GetDiffuseColor(ray, false) + indirect_sample;
+                        indirect += indirect_sample;
+                    }
+                    else if (use_irradiance_cache && IsPurelyDiffuse(ray.GetHit()))
+                    {
+                        Color indirect_sample = GetIndirectDiffuse(ray, output);
+
+                        diffuse += GetDiffuseColor(ray, false) + indirect_sample;
+                        indirect += indirect_sample;
+                    }
+                    else
+                    {
+                        Color direct_sample;
+                        Color diffuse_sample = GetDiffuseColor(ray, GI, 0, &direct_sample);
+
+                        // A NaN path would spoil the whole pixel, the sample is left out of the cell instead.
+                        if (!diffuse_sample.IsFinite())
+                        {
+                            invalid_samples++;
+                            STAT_COUNT(InvalidGISamples);
+                            continue;
+                        }
+
+                        diffuse += diffuse_sample;
+                        indirect += diffuse_sample - direct_sample;
+                    }
+
+                    ambient.AddMul(GetAmbientColor(ray), Camera::GetInstance().AmbientIntensity());
                 }
                 else
                 {
                     ambient += output.GetBgColor();
                 }
             }
+            // A cell whose samples were all dropped is left out instead of averaging to NaN.
+            if (invalid_samples >= sample_size) continue;
+            valid_cells++;
+
             out_final_ambient += ambient / (sample_size - invalid_samples);
 
             out_final_diffuse += diffuse / (sample_size - invalid_samples);
 
+            out_final_indirect += indirect / (sample_size - invalid_samples);
+
+            out_sample_count += (unsigned int)sample_size - invalid_samples;
+
         }
     }
 
+    if (valid_cells == 0) return;
+
     //Final Colors
-    out_final_ambient /= grid_cell_count;
-    out_final_diffuse /= grid_cell_count;
+    out_final_ambient /= valid_cells;
+    out_final_diffuse /= valid_cells;
+    out_final_indirect /= valid_cells;
 }
 
 Color RayTracer::GetAmbientColor(const Ray& ray)
 {
-    Geometry& geo = *ray.hit_obj;
-    return geo.GetAmbientColor() * geo.GetAmbientCoeff();
+    return MaterialOf(ray.GetHit()).ambient;
 }
 
-Vector3d RayTracer::GetNormal(const Ray& ray)
-{
-    if (ray.hit_obj->GetType().compare(SPHERE) == 0)  return (ray.GetHitCoor() - (*(Sphere*)(ray.hit_obj)).GetCenter()).normalized();
-    else if (ray.hit_obj->GetType().compare(RECTANGLE) == 0) return (*(Rectangle*)(ray.hit_obj)).GetNormal();
-    else {
-        PRINT("Something went wrong...");
-        return Vector3d();
-    }
-}
 
 #pragma endregion
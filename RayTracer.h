@@ -12,6 +12,10 @@
 #include "Ray.h"
 #include "Camera.h"
 #include "YuMath.h" 
+#include "IrradianceCache.h"
+#include "PhotonMap.h"
+#include "Statistics.h"
+#include "MappedImage.h"
 
 #include <cstdio>
 #include <iostream>
@@ -25,9 +29,13 @@
 #endif
 
 
-extern void JSONReadGeometries(std::vector<Geometry*>& scene_geo, nlohmann::json& geometries);
-extern void JSONReadLights(std::vector<Light*>& scene_lights, nlohmann::json& lights);
-extern void JSONReadOutput(std::vector<Output*>& scene_outputs, nlohmann::json& output);
+// The readers that return false could not load their part, the scene is then incomplete.
+extern bool JSONReadGeometries(Scene& scene, nlohmann::json& geometries);
+extern bool JSONReadLights(Scene& scene, nlohmann::json& lights);
+extern void JSONReadOutput(Scene& scene, nlohmann::json& output);
+extern void JSONReadSequence(Scene& scene, nlohmann::json& sequence);
+// Moves the keyframed elements of the scene to where they are at the frame.
+extern void JSONApplyFrame(Scene& scene, unsigned int frame);
 
 
 static const float RESOLUTION = 1.00f;
@@ -35,34 +43,124 @@ static const float RESOLUTION = 1.00f;
 using namespace Eigen;
 struct Hit;
 
+enum class Lobe { Diffuse, Specular };
+
+// Render configurations the pixel loop is compiled for, every combination gets its own kernel.
+enum TraceFeatures : unsigned int
+{
+    TRACE_AA = 1 << 0,
+    TRACE_GI = 1 << 1,
+    TRACE_SPECULAR = 1 << 2,
+    TRACE_AREA_LIGHTS = 1 << 3, // Some area lights are sampled instead of lit from their centre
+    TRACE_KERNEL_COUNT = 1 << 4
+};
+
+// What the shading of a hit needs on top of its hit record, worked out once per hit instead of once per light and lobe.
+struct ShadingPoint
+{
+    const HitRecord& hit;
+    Vector3d towards_camera;
+    const Material& material;
+};
+
+// Wall time in seconds spent in each phase of the last run, summed over the outputs.
+struct PhaseTimes
+{
+    double build = 0.0;
+    double setup = 0.0;
+    double trace = 0.0;
+    double denoise = 0.0;
+    double save = 0.0;
+
+    double Total() const { return build + setup + trace + denoise + save; }
+};
+
 class RayTracer
 {
+    friend class Microbenchmark; // Times the private kernels on their own
+
 private:
     nlohmann::json json_file;
     Scene scene;
 
+    IrradianceCache irradiance_cache;
+
+    PhotonMap photon_map;
+    double photon_radius = 0.0; // Gather radius of the current photon pass
+
+    PhaseTimes phase_times;
+    Statistics::Report statistics; // Summed over the outputs of the last run
+    bool save_outputs = true;
+    bool scene_built = false;
+
+    MappedImage tiled_image; // File the tiles of a tiled output are written to
+    bool tiles_streamed = false; // The current output is already in its file
+
+    typedef void (RayTracer::*TraceKernel)(const Output& output, std::vector<Color>& buffer, MappedImage* tiled);
+    static const TraceKernel trace_kernels[TRACE_KERNEL_COUNT];
+    TraceKernel trace_kernel = nullptr; // Picked by SetupCamera for the current output
+
 public:
     RayTracer() = delete;
     RayTracer(nlohmann::json json_file);
 
     ~RayTracer();
 
-    /// Main function that starts the tracer.
-    void run();
+    /// Main function that starts the tracer. A sequence renders every output for each of its frames.
+    /// Returns false when the scene can't be built, nothing is rendered then.
+    bool run();
+
+    inline const PhaseTimes& GetPhaseTimes() const { return phase_times; }
+    /// Empty unless the tracer is built with RAYTRACER_STATS.
+    inline const Statistics::Report& GetStatistics() const { return statistics; }
+    /// Benchmarks turn this off so the disk does not weigh in the timings.
+    inline void SetSaveOutputs(bool save) { save_outputs = save; }
+
+    /// Traces one output into out_image without saving it, unclamped. Returns false when there is no such output or the scene can't be built.
+    /// The scene is only built once, so calling it again renders a new independent pass. The phase times add up over the calls.
+    bool RenderOutput(size_t output_index, std::vector<Color>& out_image);
 
 private: 
-    /// Builds scene from json file
-    void BuildScene();
+    /// Builds scene from json file, returns false when it can't be built.
+    bool BuildScene();
+    /// Moves the scene to a frame of its sequence and refits the BVHs around it.
+    void SetFrame(unsigned int frame);
 
     void SetupCamera(const Output& output);
 
     /// Starts tracing the scene
     void Trace(const Output& output);
+    // With a tiled image every finished tile goes to it and the buffer is left alone.
+    void TraceTiles(const Output& output, std::vector<Color>& buffer, MappedImage* tiled = nullptr);
+    TraceKernel SelectTraceKernel(const Output& output);
+    // The feature checks of the pixel loop are resolved at compile time, FEATURES is a combination of TraceFeatures.
+    template <unsigned int FEATURES>
+    void TraceTilesKernel(const Output& output, std::vector<Color>& buffer, MappedImage* tiled);
+    // Tiled outputs only stream when nothing needs the whole image in memory.
+    bool StreamsTiles(const Output& output) const;
+    template <unsigned int FEATURES>
+    Color TracePixel(uint32_t x, uint32_t y, const Output& output);
+    /// Filters the traced image with the feature buffers.
+    void Denoise(const Output& output);
     /// Save current scene data as .ppm file.
     void SaveToPPM(const Output& output);
-
-    // Saves which closest object to ray origin is hit, or nothing is hit.
+    /// Save the AOVs the output asks for next to the image.
+    void SaveAOVs(const Output& output);
+    /// Print the counters of the output and save them as JSON next to the image.
+    void SaveStatistics(const Output& output, const Statistics::Report& report);
+    std::string SideCarBaseName(const Output& output);
+    std::string OutputPath(const std::string& file_name);
+    void WritePPM(const std::string& file_name, const std::vector<Color>& buffer);
+    Color IdColor(unsigned int id, unsigned int instance);
+    Color HeatmapColor(double t);
+
+    // Saves the hit record of the closest object to ray origin, or returns false when nothing is hit.
     bool Raycast(Ray& ray, double max_distance = DBL_MAX);
+    HitRecord MakeHitRecord(const Hit& found, double distance);
+
+    // Calls on_hit for the intersections closer than max_distance, through the top level and the group BVHs.
+    template <typename OnHit>
+    void TraverseScene(const Ray& ray, double max_distance, OnHit on_hit);
 
     // Returns an array of object that ray intersected with.
     std::vector<Hit> RaycastAll(const Ray& ray, double max_distance);
@@ -71,23 +169,52 @@ private:
     bool IntersectCoor(const Ray& ray, Sphere& sphere, Vector3d& intersect);
     bool IntersectCoor(const Ray& ray, Rectangle& rect, Vector3d& intersect);
 
-    Color CalculatePointLightDiffuse(const Vector3d& center, const Color& diffuse_intensity, const Ray& ray, bool& gl);
+    Color CalculatePointLightDiffuse(const Vector3d& center, const Color& diffuse_intensity, const Ray& ray, bool& gl, unsigned int hit_count = 0, Color* out_direct = nullptr);
 
-    Color GetDiffuseColor(const Ray& ray, bool gl);
+    // out_direct, when given, receives the part lit straight by the lights.
+    Color GetDiffuseColor(const Ray& ray, bool gl = true, unsigned int hit_count = 0, Color* out_direct = nullptr);
     Color GetSpecularColor(const Ray& ray);
 
+    ShadingPoint MakeShadingPoint(const Ray& ray);
+    // Adds the direct light of every light to the lobes that are given, one shadow ray per light sample serves both.
+    // Without AREA_LIGHTS every area light is lit from its centre.
+    template <bool AREA_LIGHTS = true>
+    void ShadeDirect(const Ray& ray, Color* out_diffuse, Color* out_specular);
+
     Color GetAmbientColor(const Ray& ray);
 
     bool IsLightHidden(const Vector3d& light_center, const Ray& ray);
 
     double BlinnPhong(const Vector3d& normal, const Vector3d& towards_light, const Vector3d& towards_camera);
 
-    void UseMSAA(const Vector3d& px, const Vector3d& py, Color& out_final_ambient, Color& out_final_diffuse, const Output& output, const bool& gl);
+    template <bool GI>
+    void UseMSAA(const Vector3d& px, const Vector3d& py, Color& out_final_ambient, Color& out_final_diffuse, Color& out_final_indirect, unsigned int& out_sample_count, const Output& output);
+
+
+    Color Helper_CalculatePointLightDiffuse(const Vector3d& center, const Color& diffuse_intensity, const Ray& ray, unsigned int hit_count, bool& gl, Color* out_direct = nullptr);
+
+    // Indirect diffuse light interpolated from, or added to, the irradiance cache.
+    Color GetIndirectDiffuse(const Ray& ray, const Output& output);
+    IrradianceRecord ComputeIrradianceRecord(const Ray& ray, const Vector3d& hit_normal, unsigned int samples);
+    bool IsPurelyDiffuse(const HitRecord& hit);
+
+    inline const Material& MaterialOf(const HitRecord& hit) const { return scene.GetMaterials()[hit.material]; }
+
+    // Fills the photon map with the indirect light of one pass.
+    void EmitPhotons(const Output& output);
+    void TracePhoton(Light& light, unsigned int light_photons, std::vector<Photon>& out_photons);
+    // Indirect diffuse light from the photon density around the hit.
+    Color GetPhotonIndirect(const Ray& ray);
 
-    Vector3d GetNormal(const Ray& ray);
+    // Direct light of an area light through multiple importance sampling of the light and the lobe, added to the lobes that are given.
+    void SampleAreaLight(AreaLight& area, const ShadingPoint& point, const Ray& ray, Color* out_diffuse, Color* out_specular);
 
+    // Lobe shading of a single light direction, cosine included.
+    Color EvaluateLobe(const ShadingPoint& point, const Vector3d& towards_light, const Light& light, Lobe lobe);
+    double LobePdf(const ShadingPoint& point, const Vector3d& towards_light, Lobe lobe);
 
-    Color Helper_CalculatePointLightDiffuse(const Vector3d& center, const Color& diffuse_intensity, const Ray& ray, unsigned int hit_count, bool& gl);
+    // Importance samples the next bounce from the diffuse and Blinn-Phong lobes, out_weight is bsdf * cos / pdf.
+    bool SampleBSDF(const Ray& ray, const Vector3d& hit_normal, Vector3d& out_dir, Color& out_weight);
 };
 
 
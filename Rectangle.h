@@ -10,10 +10,10 @@
 class Rectangle : public Geometry
 {
 public:
-    Rectangle() {}
+    Rectangle() : Geometry(GeometryType::Rectangle, 0) {}
 
     Rectangle(Eigen::Vector3d& p1, Eigen::Vector3d& p2, Eigen::Vector3d& p3, Eigen::Vector3d& p4)
-        :p1(p1), p2(p2), p3(p3), p4(p4)
+        : Geometry(GeometryType::Rectangle, 0), p1(p1), p2(p2), p3(p3), p4(p4)
     {
         auto diag1 = (p3 - p1).norm();
         auto diag2 = (p4 - p2).norm();
@@ -26,8 +26,8 @@ public:
         normal = ((p2 - p1).cross(p4 - p1)).normalized();
     }
 
-    Rectangle(std::string& type, std::string name, float& ka, float& kd, float& ks, float& pc, Color& ac, Color& dc, Color& sc, Eigen::Vector3d& p1, Eigen::Vector3d& p2, Eigen::Vector3d& p3, Eigen::Vector3d& p4)
-        : Geometry(type, name, ka, kd, ks, pc, ac, dc, sc), p1(p1), p2(p2), p3(p3), p4(p4) 
+    Rectangle(uint16_t material, Eigen::Vector3d& p1, Eigen::Vector3d& p2, Eigen::Vector3d& p3, Eigen::Vector3d& p4)
+        : Geometry(GeometryType::Rectangle, material), p1(p1), p2(p2), p3(p3), p4(p4) 
     {
         auto diag1 = (p3 - p1).norm();
         auto diag2 = (p4 - p2).norm();
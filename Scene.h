@@ -3,18 +3,41 @@
 
 #include <vector>
 #include <iostream>
+#include <cfloat>
 
 #include "Rectangle.h"
 #include "Sphere.h"
 #include "AreaLight.h"
 #include "PointLight.h"
 #include "Output.h"
+#include "Arena.h"
+#include "Material.h"
+#include "Instance.h"
+#include "BVH.h"
+#include "Animation.h"
 
 class Scene
 {
 private: 
 
-    // Change Geometry to shared pointer and the vector as simple pointers
+    // Every object lives in the arena of its type, the vectors point into them in the order of the scene file.
+    Arena<Sphere> spheres;
+    Arena<Rectangle> rectangles;
+    Arena<PointLight> point_lights;
+    Arena<AreaLight> area_lights;
+    Arena<Output> output_storage;
+
+    MaterialTable materials;
+
+    // Every geometry belongs to one group, the loose ones to the root group. Rays only see the groups through
+    // the instances, found with the top level BVH over the instance boxes.
+    Arena<GeometryGroup> groups;
+    Arena<Instance> instances;
+    BVH top_level;
+    std::vector<Bounds> item_bounds; // Scratch of the BVH builds, kept so refitting every frame allocates nothing
+
+    SequenceSettings sequence;
+    std::vector<AnimatedElement> animated;
 
     std::vector<Geometry*> geometries;
     std::vector<Light*> lights;
@@ -23,17 +46,138 @@ private:
 public:
 
     Scene() {}
-    ~Scene() 
-    {
-        for (auto geo : geometries) delete geo;
-        for (auto light : lights) delete light;
-        for (auto output : outputs) delete output;
-    }
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
 
     auto& GetGeometries() { return geometries; }
     auto& GetLights() { return lights; }
     auto& GetOutputs() { return outputs; }
 
+    auto& GetSpheres() { return spheres; }
+    auto& GetRectangles() { return rectangles; }
+    auto& GetPointLights() { return point_lights; }
+    auto& GetAreaLights() { return area_lights; }
+    auto& GetOutputStorage() { return output_storage; }
+
+    auto& GetMaterials() { return materials; }
+    const auto& GetMaterials() const { return materials; }
+
+    auto& GetGroups() { return groups; }
+    auto& GetInstances() { return instances; }
+    const auto& GetInstances() const { return instances; }
+    const auto& GetTopLevel() const { return top_level; }
+
+    auto& GetSequence() { return sequence; }
+    auto& GetAnimated() { return animated; }
+
+    // Destroys every object but keeps the arenas, loading a scene of the same size again allocates nothing.
+    void Clear()
+    {
+        geometries.clear();
+        lights.clear();
+        outputs.clear();
+
+        spheres.Clear();
+        rectangles.Clear();
+        point_lights.Clear();
+        area_lights.Clear();
+        output_storage.Clear();
+
+        materials.Clear();
+
+        instances.Clear();
+        groups.Clear();
+        top_level.Clear();
+
+        sequence = SequenceSettings();
+        animated.clear();
+    }
+
+    // Builds the BVH of every group, then the top level one over the placed instances.
+    void BuildAcceleration()
+    {
+        for (GeometryGroup& group : groups)
+        {
+            group.bvh.Build(GroupBounds(group));
+            group.moved = false;
+        }
+
+        top_level.Build(InstanceBounds());
+    }
+
+    // Fits the BVHs of the groups whose geometry moved, then the top level one, to where things are now. A BVH whose
+    // nodes grew past rebuild_ratio times their area after the build is built again. Returns how many were built again.
+    unsigned int RefitAcceleration(double rebuild_ratio)
+    {
+        unsigned int rebuilt = 0;
+
+        for (GeometryGroup& group : groups)
+        {
+            if (!group.moved) continue;
+
+            if (Refit(group.bvh, GroupBounds(group), rebuild_ratio)) rebuilt++;
+            group.moved = false;
+        }
+
+        if (Refit(top_level, InstanceBounds(), rebuild_ratio)) rebuilt++;
+
+        return rebuilt;
+    }
+
+    const std::vector<Bounds>& GroupBounds(const GeometryGroup& group)
+    {
+        item_bounds.clear();
+        for (Geometry* geo : group.geometries) item_bounds.push_back(GeometryBounds(*geo));
+
+        return item_bounds;
+    }
+
+    const std::vector<Bounds>& InstanceBounds()
+    {
+        item_bounds.clear();
+        for (Instance& instance : instances)
+        {
+            instance.UpdateBounds();
+            item_bounds.push_back(instance.GetBounds());
+        }
+
+        return item_bounds;
+    }
+
+    static bool Refit(BVH& bvh, const std::vector<Bounds>& item_bounds, double rebuild_ratio)
+    {
+        bvh.Refit(item_bounds);
+        if (bvh.Degradation() <= rebuild_ratio) return false;
+
+        bvh.Build(item_bounds);
+        return true;
+    }
+
+    static Bounds GeometryBounds(const Geometry& geo)
+    {
+        Bounds bounds;
+
+        if (geo.GetType() == GeometryType::Sphere)
+        {
+            const Sphere& sphere = (const Sphere&)geo;
+            Eigen::Vector3d radius = Eigen::Vector3d::Constant(sphere.GetRadius());
+
+            bounds.Grow(sphere.GetCenter() - radius);
+            bounds.Grow(sphere.GetCenter() + radius);
+        }
+        else if (geo.GetType() == GeometryType::Rectangle)
+        {
+            const Rectangle& rect = (const Rectangle&)geo;
+
+            for (const Eigen::Vector3d& point : { rect.GetP1(), rect.GetP2(), rect.GetP3(), rect.GetP4() }) bounds.Grow(point);
+        }
+
+        bounds.Pad(1e-6 * (1.0 + std::max(bounds.min.cwiseAbs().maxCoeff(), bounds.max.cwiseAbs().maxCoeff())));
+
+        return bounds;
+    }
+
     bool HasAreaLight() {
         for (Light* l: lights)
         {
@@ -45,6 +189,15 @@ public:
         return false;
     }
 
+    // Axis aligned box around every placed geometry of the scene, BuildAcceleration has to be called first.
+    void GetBounds(Eigen::Vector3d& out_min, Eigen::Vector3d& out_max)
+    {
+        Bounds bounds = top_level.GetBounds();
+
+        out_min = bounds.min;
+        out_max = bounds.max;
+    }
+
     //void PrintGeometries() 
     //{
     //    size_t size = geometries->size();
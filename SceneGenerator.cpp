@@ -0,0 +1,227 @@
+#include "SceneGenerator.h"
+
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "EigenIncludes.h"
+#include "YuMath.h"
+
+namespace SceneGenerator
+{
+	// The standard distributions differ between libraries, only the engine is guaranteed to give the same numbers.
+	class Random
+	{
+	public:
+		Random(uint64_t seed) : engine(seed) {}
+
+		double Uniform() { return (engine() >> 11) * (1.0 / 9007199254740992.0); } // [0, 1) from the top 53 bits
+		double Uniform(double min, double max) { return min + (max - min) * Uniform(); }
+
+		// Box-Muller, one of the two values is dropped to keep the sequence simple.
+		double Normal()
+		{
+			double u = std::max(Uniform(), 1e-300);
+			return std::sqrt(-2.0 * std::log(u)) * std::cos(2.0 * PI * Uniform());
+		}
+
+		Eigen::Vector3d InCube(double half_size) { return Eigen::Vector3d(Uniform(-half_size, half_size), Uniform(-half_size, half_size), Uniform(-half_size, half_size)); }
+
+		Eigen::Vector3d Direction()
+		{
+			double z = Uniform(-1.0, 1.0);
+			double phi = 2.0 * PI * Uniform();
+			double r = std::sqrt(std::max(0.0, 1.0 - z * z));
+
+			return Eigen::Vector3d(r * std::cos(phi), r * std::sin(phi), z);
+		}
+
+	private:
+		std::mt19937_64 engine;
+	};
+
+	static nlohmann::json Vector(const Eigen::Vector3d& v) { return { v.x(), v.y(), v.z() }; }
+
+	static nlohmann::json Material(Random& random)
+	{
+		double r = random.Uniform(0.2, 1.0), g = random.Uniform(0.2, 1.0), b = random.Uniform(0.2, 1.0);
+		double ks = random.Uniform(0.0, 0.5);
+
+		return {
+			{"ac", {r, g, b}}, {"dc", {r, g, b}}, {"sc", {1, 1, 1}},
+			{"ka", 0.1}, {"kd", 1.0 - ks}, {"ks", ks}, {"pc", random.Uniform(2.0, 64.0)}
+		};
+	}
+
+	// Calls on_element(section, element) for every element of the scene in file order, both Generate and Write go through
+	// it so they draw the random numbers in the same order.
+	template <typename OnElement>
+	static void ForEachElement(const Settings& settings, OnElement on_element)
+	{
+		Random random(settings.seed);
+
+		const size_t primitives = std::max<size_t>(1, settings.spheres + settings.rectangles);
+		const double extent = settings.extent;
+
+		// An instanced group fills a smaller cube, each placement taking its share of the scene.
+		const double group_extent = settings.instances > 0 ? extent / std::cbrt((double)settings.instances) : extent;
+
+		// Primitives get smaller as they get more numerous so the scene keeps about the same occupancy.
+		const double size = group_extent / std::cbrt((double)primitives);
+		const double cluster_spread = 0.1 * group_extent;
+
+		std::vector<nlohmann::json> palette;
+		for (unsigned int i = 0; i < std::max(1u, settings.materials); i++) palette.push_back(Material(random));
+
+		auto material = [&]() { return palette[std::min((size_t)(random.Uniform() * palette.size()), palette.size() - 1)]; };
+
+		std::vector<Eigen::Vector3d> centres;
+		for (unsigned int i = 0; i < std::max(1u, settings.clusters); i++) centres.push_back(random.InCube(group_extent - cluster_spread));
+
+		auto position = [&]()
+		{
+			if (random.Uniform() >= settings.clustering) return random.InCube(group_extent);
+
+			const Eigen::Vector3d& centre = centres[std::min((size_t)(random.Uniform() * centres.size()), centres.size() - 1)];
+			return Eigen::Vector3d(centre + cluster_spread * Eigen::Vector3d(random.Normal(), random.Normal(), random.Normal()));
+		};
+
+		nlohmann::json group = { {"type", "group"}, {"name", "generated"}, {"geometry", nlohmann::json::array()} };
+
+		auto add_primitive = [&](const nlohmann::json& primitive)
+		{
+			if (settings.instances > 0) group["geometry"].push_back(primitive);
+			else on_element("geometry", primitive);
+		};
+
+		for (size_t i = 0; i < settings.spheres; i++)
+		{
+			nlohmann::json sphere = material();
+			sphere["type"] = "sphere";
+			sphere["centre"] = Vector(position());
+			sphere["radius"] = size * random.Uniform(0.1, 0.3);
+
+			add_primitive(sphere);
+		}
+
+		for (size_t i = 0; i < settings.rectangles; i++)
+		{
+			Eigen::Vector3d centre = position();
+			Eigen::Vector3d normal = random.Direction();
+			Eigen::Vector3d u = normal.cross(std::abs(normal.x()) < 0.9 ? Eigen::Vector3d::UnitX() : Eigen::Vector3d::UnitY()).normalized() * size * random.Uniform(0.1, 0.4);
+			Eigen::Vector3d v = normal.cross(u).normalized() * size * random.Uniform(0.1, 0.4);
+
+			nlohmann::json rectangle = material();
+			rectangle["type"] = "rectangle";
+			rectangle["p1"] = Vector(centre - u - v);
+			rectangle["p2"] = Vector(centre + u - v);
+			rectangle["p3"] = Vector(centre + u + v);
+			rectangle["p4"] = Vector(centre - u + v);
+
+			add_primitive(rectangle);
+		}
+
+		if (settings.instances > 0)
+		{
+			on_element("geometry", group);
+
+			for (size_t i = 0; i < settings.instances; i++)
+			{
+				on_element("geometry", nlohmann::json{ {"type", "instance"}, {"group", "generated"}, {"translate", Vector(random.InCube(extent - group_extent))},
+													   {"rotate", {0.0, random.Uniform(0.0, 360.0), 0.0}} });
+			}
+		}
+
+		// The total light stays the same whatever the count so the images keep the same exposure.
+		const size_t lights = std::max<size_t>(1, settings.point_lights + settings.area_lights);
+		const double intensity = 1.0 / lights;
+
+		for (size_t i = 0; i < settings.point_lights; i++)
+		{
+			Eigen::Vector3d centre = random.InCube(extent);
+			centre.y() = extent * random.Uniform(1.1, 1.5);
+
+			on_element("light", nlohmann::json{ {"type", "point"}, {"centre", Vector(centre)},
+												{"id", {intensity, intensity, intensity}}, {"is", {intensity, intensity, intensity}} });
+		}
+
+		for (size_t i = 0; i < settings.area_lights; i++)
+		{
+			Eigen::Vector3d centre = random.InCube(extent);
+			centre.y() = extent * random.Uniform(1.1, 1.5);
+			double half = 0.5 * size * random.Uniform(0.5, 1.5);
+
+			// Facing down, the scene is below.
+			on_element("light", nlohmann::json{ {"type", "area"},
+												{"p1", Vector(centre + Eigen::Vector3d(-half, 0, -half))}, {"p2", Vector(centre + Eigen::Vector3d(half, 0, -half))},
+												{"p3", Vector(centre + Eigen::Vector3d(half, 0, half))}, {"p4", Vector(centre + Eigen::Vector3d(-half, 0, half))},
+												{"n", 2}, {"id", {intensity, intensity, intensity}}, {"is", {intensity, intensity, intensity}} });
+		}
+
+		nlohmann::json output = {
+			{"filename", settings.file_name}, {"size", {settings.width, settings.height}}, {"lookat", {0, 0, -1}}, {"up", {0, 1, 0}},
+			{"fov", 45}, {"centre", {0.0, 0.0, 3.5 * extent}}, {"ai", {1, 1, 1}}, {"bkc", {0.1, 0.1, 0.1}}
+		};
+
+		if (settings.global_illum)
+		{
+			output["globalillum"] = true;
+			output["raysperpixel"] = {2, 2};
+			output["maxbounces"] = 3;
+			output["probterminate"] = 0.333;
+		}
+
+		on_element("output", output);
+	}
+
+	nlohmann::json Generate(const Settings& settings)
+	{
+		nlohmann::json scene = { {"geometry", nlohmann::json::array()}, {"light", nlohmann::json::array()}, {"output", nlohmann::json::array()} };
+
+		ForEachElement(settings, [&](const char* section, const nlohmann::json& element) { scene[section].push_back(element); });
+
+		return scene;
+	}
+
+	bool Write(const Settings& settings, const std::string& file_name)
+	{
+		std::ofstream ofs(file_name);
+		if (!ofs) return false;
+
+		// The reader needs every section even when it is empty.
+		static const char* sections[] = { "geometry", "light", "output" };
+		int open_section = -1;
+		bool first_element = true;
+
+		auto open_until = [&](int section)
+		{
+			while (open_section < section)
+			{
+				ofs << (open_section < 0 ? "{\n" : "\n],\n");
+				open_section++;
+				ofs << '"' << sections[open_section] << "\": [\n";
+				first_element = true;
+			}
+		};
+
+		ForEachElement(settings, [&](const char* section, const nlohmann::json& element)
+		{
+			int index = 0;
+			while (std::string(sections[index]).compare(section) != 0) index++;
+
+			open_until(index);
+
+			if (!first_element) ofs << ",\n";
+			first_element = false;
+
+			ofs << element.dump();
+		});
+
+		open_until(2);
+		ofs << "\n]\n}\n";
+
+		return (bool)ofs;
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef SCENE_GENERATOR_H
+#define SCENE_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+#if STUDENT_SOLUTION || COURSE_SOLUTION
+#include "../external/json.hpp"
+#else
+#include "external/json.hpp"
+#endif
+
+// Makes scenes of any size for stress and scaling tests. The same settings and seed always give the same scene,
+// on every platform, so runs with different primitive counts can be compared.
+namespace SceneGenerator
+{
+	struct Settings
+	{
+		uint64_t seed = 1;
+
+		size_t spheres = 100;
+		size_t rectangles = 0;
+		size_t point_lights = 1;
+		size_t area_lights = 0;
+
+		double clustering = 0.0; // Share of the primitives packed around the cluster centres, the rest is spread uniformly
+		unsigned int clusters = 8;
+		unsigned int materials = 64; // Primitives pick from a palette like real scenes do, so the material table stays small
+		double extent = 10.0; // Half size of the cube the primitives are placed in
+		size_t instances = 0; // Places the primitives as one group this many times instead of once, shrunk to keep the occupancy
+
+		std::string file_name = "generated.ppm";
+		unsigned int width = 400;
+		unsigned int height = 400;
+		bool global_illum = false;
+	};
+
+	nlohmann::json Generate(const Settings& settings);
+
+	// Streams the scene to the file one element at a time, for scenes too large to hold as a JSON tree.
+	bool Write(const Settings& settings, const std::string& file_name);
+}
+
+#endif // !SCENE_GENERATOR_H
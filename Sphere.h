@@ -11,8 +11,8 @@ class Sphere : public Geometry
 {
 
 public:
-    Sphere(std::string& type, std::string name, float& ka, float& kd, float& ks, float& pc, Color& ac, Color& dc, Color& sc, Eigen::Vector3d& center, double& radius)
-        : Geometry(type, name, ka, kd, ks, pc, ac, dc, sc), center(center), radius(radius)
+    Sphere(uint16_t material, const Eigen::Vector3d& center, double radius)
+        : Geometry(GeometryType::Sphere, material), center(center), radius(radius)
     {
     }
     ~Sphere() {};
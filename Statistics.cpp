@@ -0,0 +1,177 @@
+#include "Statistics.h"
+
+#if STUDENT_SOLUTION || COURSE_SOLUTION
+#include "../external/json.hpp"
+#else
+#include "external/json.hpp"
+#endif
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+
+namespace Statistics
+{
+	struct ThreadReport;
+
+	static Report totals; // Of the threads that exited
+	static std::vector<ThreadReport*> thread_reports; // Of the running threads, the workers of Parallel::For are kept between calls
+	static std::mutex totals_mutex;
+
+	struct ThreadReport
+	{
+		Report report;
+		size_t light = 0;
+
+		ThreadReport()
+		{
+			std::lock_guard<std::mutex> lock(totals_mutex);
+			thread_reports.push_back(this);
+		}
+
+		~ThreadReport()
+		{
+			std::lock_guard<std::mutex> lock(totals_mutex);
+			totals += report;
+			thread_reports.erase(std::find(thread_reports.begin(), thread_reports.end(), this));
+		}
+	};
+
+	static thread_local ThreadReport thread_report;
+
+	Report& Report::operator+=(const Report& other)
+	{
+		for (int counter = 0; counter < CounterCount; counter++) counters[counter] += other.counters[counter];
+		for (unsigned int depth = 0; depth <= MAX_DEPTH; depth++) path_rays_by_depth[depth] += other.path_rays_by_depth[depth];
+
+		if (shadow_rays_per_light.size() < other.shadow_rays_per_light.size()) shadow_rays_per_light.resize(other.shadow_rays_per_light.size(), 0);
+		for (size_t light = 0; light < other.shadow_rays_per_light.size(); light++) shadow_rays_per_light[light] += other.shadow_rays_per_light[light];
+
+		for (int phase = 0; phase < PerfCounters::PhaseCount; phase++) perf[phase] += other.perf[phase];
+
+		return *this;
+	}
+
+	std::string Report::ToJSON() const
+	{
+		nlohmann::json json;
+
+		for (int counter = 0; counter < CounterCount; counter++) json[CounterName((Counter)counter)] = counters[counter];
+
+		uint64_t rays = Rays();
+		json["intersection_tests_per_ray"] = rays != 0 ? (double)counters[IntersectionTests] / rays : 0.0;
+		json["bvh_nodes_per_ray"] = rays != 0 ? (double)counters[BVHNodesVisited] / rays : 0.0;
+		json["path_rays_by_depth"] = std::vector<uint64_t>(path_rays_by_depth, path_rays_by_depth + MAX_DEPTH + 1);
+		json["shadow_rays_per_light"] = shadow_rays_per_light;
+
+		for (int phase = 0; phase < PerfCounters::PhaseCount; phase++)
+		{
+			const PerfCounters::Values& values = perf[phase];
+			if (values.counts[PerfCounters::Cycles] == 0) continue;
+
+			nlohmann::json& json_phase = json["perf"][PerfCounters::PhaseName((PerfCounters::Phase)phase)];
+
+			for (int event = 0; event < PerfCounters::EventCount; event++) json_phase[PerfCounters::EventName((PerfCounters::Event)event)] = values.counts[event];
+			json_phase["ipc"] = values.IPC();
+		}
+
+		return json.dump(4);
+	}
+
+	void Report::Print() const
+	{
+		std::cout << ">> Statistics" << std::endl;
+
+		for (int counter = 0; counter < CounterCount; counter++)
+		{
+			std::cout << "   " << CounterName((Counter)counter) << ": " << counters[counter] << std::endl;
+		}
+
+		uint64_t rays = Rays();
+		std::cout << "   intersection_tests_per_ray: " << (rays != 0 ? (double)counters[IntersectionTests] / rays : 0.0) << std::endl;
+		std::cout << "   bvh_nodes_per_ray: " << (rays != 0 ? (double)counters[BVHNodesVisited] / rays : 0.0) << std::endl;
+
+		std::cout << "   path_rays_by_depth:";
+		for (unsigned int depth = 0; depth <= MAX_DEPTH; depth++) if (path_rays_by_depth[depth] != 0) std::cout << " [" << depth << "] " << path_rays_by_depth[depth];
+		std::cout << std::endl;
+
+		std::cout << "   shadow_rays_per_light:";
+		for (size_t light = 0; light < shadow_rays_per_light.size(); light++) std::cout << " [" << light << "] " << shadow_rays_per_light[light];
+		std::cout << std::endl;
+
+		for (int phase = 0; phase < PerfCounters::PhaseCount; phase++)
+		{
+			const PerfCounters::Values& values = perf[phase];
+			if (values.counts[PerfCounters::Cycles] == 0) continue;
+
+			const uint64_t* counts = values.counts;
+
+			std::cout << "   perf " << PerfCounters::PhaseName((PerfCounters::Phase)phase) << ": ipc " << values.IPC()
+				<< ", cache misses " << counts[PerfCounters::CacheMisses] << "/" << counts[PerfCounters::CacheReferences]
+				<< ", branch misses " << counts[PerfCounters::BranchMisses] << "/" << counts[PerfCounters::BranchInstructions] << std::endl;
+		}
+	}
+
+	void Count(Counter counter, uint64_t n)
+	{
+		thread_report.report.counters[counter] += n;
+
+		if (counter == ShadowRays)
+		{
+			std::vector<uint64_t>& per_light = thread_report.report.shadow_rays_per_light;
+
+			if (per_light.size() <= thread_report.light) per_light.resize(thread_report.light + 1, 0);
+			per_light[thread_report.light] += n;
+		}
+	}
+
+	void CountPathRay(unsigned int depth)
+	{
+		thread_report.report.path_rays_by_depth[std::min(depth, MAX_DEPTH)]++;
+	}
+
+	void SetLight(size_t index)
+	{
+		thread_report.light = index;
+	}
+
+	void CountPerf(PerfCounters::Phase phase, const PerfCounters::Values& values)
+	{
+		thread_report.report.perf[phase] += values;
+	}
+
+	Report Snapshot()
+	{
+		std::lock_guard<std::mutex> lock(totals_mutex);
+
+		Report snapshot = totals;
+		for (ThreadReport* report : thread_reports) snapshot += report->report;
+
+		return snapshot;
+	}
+
+	void Reset()
+	{
+		std::lock_guard<std::mutex> lock(totals_mutex);
+
+		totals = Report();
+		for (ThreadReport* report : thread_reports) report->report = Report();
+	}
+
+	std::string CounterName(Counter counter)
+	{
+		switch (counter)
+		{
+		case PrimaryRays: return "primary_rays";
+		case ShadowRays: return "shadow_rays";
+		case IndirectRays: return "indirect_rays";
+		case IntersectionTests: return "intersection_tests";
+		case BVHNodesVisited: return "bvh_nodes_visited";
+		case RussianRouletteKills: return "russian_roulette_kills";
+		case CulledLobes: return "culled_lobes";
+		case InvalidGISamples: return "invalid_gi_samples";
+		case PhotonGathers: return "photon_gathers";
+		default: return "";
+		}
+	}
+}
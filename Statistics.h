@@ -0,0 +1,81 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PerfCounters.h"
+
+// Counters are compiled in for debug builds only unless RAYTRACER_STATS says otherwise.
+#ifndef RAYTRACER_STATS
+#if _DEBUG
+#define RAYTRACER_STATS 1
+#else
+#define RAYTRACER_STATS 0
+#endif
+#endif
+
+#if RAYTRACER_STATS
+#define STAT_COUNT(counter) Statistics::Count(Statistics::counter)
+#define STAT_COUNT_N(counter, n) Statistics::Count(Statistics::counter, n)
+#define STAT_PATH_RAY(depth) Statistics::CountPathRay(depth)
+#define STAT_SET_LIGHT(index) Statistics::SetLight(index)
+#define STAT_PERF_SCOPE(phase) PerfCounters::Scope stat_perf_scope_##phase(PerfCounters::phase)
+#else
+#define STAT_COUNT(counter)
+#define STAT_COUNT_N(counter, n)
+#define STAT_PATH_RAY(depth)
+#define STAT_SET_LIGHT(index)
+#define STAT_PERF_SCOPE(phase)
+#endif
+
+// Work counters of a render. Every thread counts on its own and the counts are only summed when they are read,
+// so the hot paths never share a cache line.
+namespace Statistics
+{
+	enum Counter
+	{
+		PrimaryRays,
+		ShadowRays,
+		IndirectRays, // Global illumination bounces, irradiance cache and photon rays
+		IntersectionTests,
+		BVHNodesVisited, // Top level and group nodes
+		RussianRouletteKills,
+		CulledLobes, // Lobes skipped with their shadow rays because the material reflects nothing through them
+		InvalidGISamples, // Bounces the BSDF could not sample, and camera samples dropped for a NaN or infinite colour
+		PhotonGathers, // Indirect light looked up in the photon map
+		CounterCount
+	};
+
+	static const unsigned int MAX_DEPTH = 16; // Deeper path rays are counted in the last bucket
+
+	struct Report
+	{
+		uint64_t counters[CounterCount] = {};
+		uint64_t path_rays_by_depth[MAX_DEPTH + 1] = {}; // Primary rays are depth 0
+		std::vector<uint64_t> shadow_rays_per_light;
+		PerfCounters::Values perf[PerfCounters::PhaseCount]; // Hardware counters, zero unless they are enabled
+
+		uint64_t Rays() const { return counters[PrimaryRays] + counters[ShadowRays] + counters[IndirectRays]; }
+
+		Report& operator+=(const Report& other);
+
+		std::string ToJSON() const;
+		void Print() const;
+	};
+
+	void Count(Counter counter, uint64_t n = 1);
+	void CountPathRay(unsigned int depth);
+	// Light whose shadow rays are counted from now on by the calling thread.
+	void SetLight(size_t index);
+	void CountPerf(PerfCounters::Phase phase, const PerfCounters::Values& values);
+
+	// Counts of every thread, finished or not. Only called between the calls of Parallel::For, while no worker counts.
+	Report Snapshot();
+	void Reset();
+
+	std::string CounterName(Counter counter);
+}
+
+#endif // !STATISTICS_H
@@ -0,0 +1,162 @@
+#include "Timeline.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Timeline
+{
+	static const size_t RING_SIZE = 1 << 14; // Spans kept per thread
+
+	struct Span
+	{
+		const char* name;
+		int64_t start_us;
+		int64_t end_us;
+		int64_t arg;
+	};
+
+	// Written by one thread only. The workers of Parallel::For are started again when the thread count changes,
+	// a buffer freed by a finished thread is handed to the next one so the viewer shows one row per worker slot.
+	struct Ring
+	{
+		std::vector<Span> spans = std::vector<Span>(RING_SIZE);
+		uint64_t count = 0;
+		unsigned int thread_id = 0;
+		bool in_use = false;
+	};
+
+	static int64_t SteadyMicroseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static std::atomic<bool> enabled{ false };
+	static std::atomic<int64_t> epoch_us{ SteadyMicroseconds() }; // Read by the recording threads while Enable may move it
+
+	static std::vector<std::unique_ptr<Ring>> rings;
+	static std::mutex rings_mutex; // Only taken when a thread records its first span
+
+	struct ThreadRing
+	{
+		Ring* ring = nullptr;
+
+		~ThreadRing()
+		{
+			if (ring == nullptr) return;
+
+			std::lock_guard<std::mutex> lock(rings_mutex);
+			ring->in_use = false;
+		}
+	};
+
+	static thread_local ThreadRing thread_ring;
+
+	static Ring& GetRing()
+	{
+		if (thread_ring.ring != nullptr) return *thread_ring.ring;
+
+		std::lock_guard<std::mutex> lock(rings_mutex);
+
+		for (auto& ring : rings)
+		{
+			if (!ring->in_use)
+			{
+				thread_ring.ring = ring.get();
+				break;
+			}
+		}
+
+		if (thread_ring.ring == nullptr)
+		{
+			rings.push_back(std::make_unique<Ring>());
+			rings.back()->thread_id = (unsigned int)rings.size() - 1;
+			thread_ring.ring = rings.back().get();
+		}
+
+		thread_ring.ring->in_use = true;
+		return *thread_ring.ring;
+	}
+
+	void Enable(bool enable)
+	{
+		std::lock_guard<std::mutex> lock(rings_mutex);
+
+		for (auto& ring : rings) ring->count = 0;
+		epoch_us.store(SteadyMicroseconds(), std::memory_order_relaxed);
+
+		enabled = enable;
+	}
+
+	bool Enabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	int64_t Now()
+	{
+		return SteadyMicroseconds() - epoch_us.load(std::memory_order_relaxed);
+	}
+
+	void Record(const char* name, int64_t start_us, int64_t end_us, int64_t arg)
+	{
+		if (!Enabled()) return;
+
+		Ring& ring = GetRing();
+		ring.spans[ring.count % RING_SIZE] = Span{ name, start_us, end_us, arg };
+		ring.count++;
+	}
+
+	static std::string Escape(const char* text)
+	{
+		std::string escaped;
+
+		for (const char* c = text; *c != '\0'; c++)
+		{
+			if (*c == '"' || *c == '\\') escaped += '\\';
+			escaped += *c;
+		}
+
+		return escaped;
+	}
+
+	bool Save(const std::string& file_name)
+	{
+		std::ofstream ofs(file_name);
+		if (!ofs) return false;
+
+		std::lock_guard<std::mutex> lock(rings_mutex);
+
+		ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+		bool first = true;
+
+		for (auto& ring : rings)
+		{
+			ofs << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->thread_id
+				<< ",\"args\":{\"name\":\"" << (ring->thread_id == 0 ? "main" : "worker " + std::to_string(ring->thread_id)) << "\"}}";
+			first = false;
+
+			uint64_t begin = ring->count > RING_SIZE ? ring->count - RING_SIZE : 0;
+
+			for (uint64_t i = begin; i < ring->count; i++)
+			{
+				const Span& span = ring->spans[i % RING_SIZE];
+
+				ofs << ",\n{\"name\":\"" << Escape(span.name) << "\",\"cat\":\"raytracer\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->thread_id
+					<< ",\"ts\":" << span.start_us << ",\"dur\":" << (span.end_us - span.start_us);
+
+				if (span.arg >= 0) ofs << ",\"args\":{\"value\":" << span.arg << "}";
+
+				ofs << "}";
+			}
+		}
+
+		ofs << "\n]}" << std::endl;
+
+		return true;
+	}
+}
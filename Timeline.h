@@ -0,0 +1,50 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <cstdint>
+#include <string>
+
+// Opt-in recorder of timed spans, saved as Chrome trace-event JSON (chrome://tracing or ui.perfetto.dev).
+// Every thread writes to its own ring buffer without locking, the oldest spans are overwritten when it is full.
+namespace Timeline
+{
+	// Spans are only recorded while enabled, enabling clears the spans recorded before.
+	void Enable(bool enable);
+	bool Enabled();
+
+	// Name must outlive the recording, string literals are meant to be used.
+	void Record(const char* name, int64_t start_us, int64_t end_us, int64_t arg);
+	int64_t Now(); // Microseconds since the recording started
+
+	// Writes the spans of every thread, call it once the workers are done.
+	bool Save(const std::string& file_name);
+
+	// Records the span from its construction to its destruction, arg shows in the viewer unless negative.
+	class Scope
+	{
+	public:
+		Scope(const char* name, int64_t arg = -1)
+			: name(name), arg(arg), start(Enabled() ? Now() : -1)
+		{
+		}
+
+		~Scope()
+		{
+			if (start >= 0) Record(name, start, Now(), arg);
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char* name;
+		int64_t arg;
+		int64_t start;
+	};
+}
+
+#define TIMELINE_CONCAT_(a, b) a##b
+#define TIMELINE_CONCAT(a, b) TIMELINE_CONCAT_(a, b)
+#define TIMELINE_SCOPE(...) Timeline::Scope TIMELINE_CONCAT(timeline_scope_, __LINE__)(__VA_ARGS__)
+
+#endif // !TIMELINE_H
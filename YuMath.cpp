@@ -1,6 +1,8 @@
 
 #include "YuMath.h"
 
+#include <algorithm>
+
 namespace YuMath
 {
 	double Discriminant(double a, double b, double c) { return b * b - 4.0f * a * c; }
@@ -90,4 +92,85 @@ namespace YuMath
 
 		return (normal.dot(rand_vector) < 0 ? -rand_vector : rand_vector);
 	}
+
+	ONB::ONB(const Vector3d& normal)
+		: w(normal)
+	{
+		// Branchless basis from Duff et al., stays stable when normal is close to -z.
+		double sign = std::copysign(1.0, normal.z());
+		double a = -1.0 / (sign + normal.z());
+		double b = normal.x() * normal.y() * a;
+
+		u = Vector3d(1.0 + sign * normal.x() * normal.x() * a, sign * b, -sign * normal.x());
+		v = Vector3d(b, sign + normal.y() * normal.y() * a, -normal.y());
+	}
+
+	Vector3d UniformSampleSphere()
+	{
+		double z = 1.0 - 2.0 * CustomRandom::GetInstance().Generate();
+		double radius = std::sqrt(std::max(0.0, 1.0 - z * z));
+		double phi = 2.0 * PI * CustomRandom::GetInstance().Generate();
+
+		return Vector3d(radius * std::cos(phi), radius * std::sin(phi), z);
+	}
+
+	Vector3d CosineSampleHemisphere(const Vector3d& normal, double& out_pdf)
+	{
+		double r1 = CustomRandom::GetInstance().Generate();
+		double r2 = CustomRandom::GetInstance().Generate();
+
+		double phi = 2.0 * PI * r1;
+		double radius = std::sqrt(r2);
+		double z = std::sqrt(std::max(0.0, 1.0 - r2));
+
+		out_pdf = z / PI;
+
+		return ONB(normal).ToWorld(radius * std::cos(phi), radius * std::sin(phi), z);
+	}
+
+	double CosineHemispherePdf(const Vector3d& normal, const Vector3d& dir)
+	{
+		double cos_angle = normal.dot(dir);
+		return cos_angle > 0.0 ? cos_angle / PI : 0.0;
+	}
+
+	Vector3d SampleBlinnPhong(const Vector3d& normal, const Vector3d& towards_camera, double exponent, double& out_pdf)
+	{
+		double r1 = CustomRandom::GetInstance().Generate();
+		double r2 = CustomRandom::GetInstance().Generate();
+
+		double cos_half = std::pow(r1, 1.0 / (exponent + 1.0));
+		double sin_half = std::sqrt(std::max(0.0, 1.0 - cos_half * cos_half));
+		double phi = 2.0 * PI * r2;
+
+		Vector3d half = ONB(normal).ToWorld(sin_half * std::cos(phi), sin_half * std::sin(phi), cos_half);
+		Vector3d towards_light = Reflect(half, towards_camera);
+
+		out_pdf = BlinnPhongPdf(normal, towards_camera, towards_light, exponent);
+
+		return towards_light;
+	}
+
+	double BlinnPhongPdf(const Vector3d& normal, const Vector3d& towards_camera, const Vector3d& towards_light, double exponent)
+	{
+		Vector3d half = (towards_camera + towards_light).normalized();
+
+		double cos_half = normal.dot(half);
+		double camera_dot_half = towards_camera.dot(half);
+
+		if (cos_half <= 0.0 || camera_dot_half <= 0.0) return 0.0;
+
+		// pdf of the half vector, moved to the reflected direction by the 1 / (4 wo.h) jacobian
+		return (exponent + 1.0) / (2.0 * PI) * std::pow(cos_half, exponent) / (4.0 * camera_dot_half);
+	}
+
+	double PowerHeuristic(double pdf_a, double pdf_b)
+	{
+		double a = pdf_a * pdf_a;
+		double b = pdf_b * pdf_b;
+
+		if (a + b <= 0.0) return 0.0;
+
+		return a / (a + b);
+	}
 }
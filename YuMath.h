@@ -47,6 +47,30 @@ namespace YuMath
 	Vector3d ReflectRand(const Vector3d& normal, const Vector3d& inverse, const float rand_num);
 
 	Vector3d RandomDir(const Vector3d& normal);
+
+	// Orthonormal basis where w is the given unit vector.
+	struct ONB
+	{
+		Vector3d u, v, w;
+
+		ONB(const Vector3d& normal);
+
+		Vector3d ToWorld(double x, double y, double z) const { return x * u + y * v + z * w; }
+	};
+
+	// Uniform direction over the whole sphere, pdf = 1 / (4 * PI).
+	Vector3d UniformSampleSphere();
+
+	// Cosine weighted direction in the hemisphere of normal, pdf = cos / PI.
+	Vector3d CosineSampleHemisphere(const Vector3d& normal, double& out_pdf);
+	double CosineHemispherePdf(const Vector3d& normal, const Vector3d& dir);
+
+	// Samples the Blinn-Phong lobe through its half vector, pdf is in solid angle of the returned direction.
+	Vector3d SampleBlinnPhong(const Vector3d& normal, const Vector3d& towards_camera, double exponent, double& out_pdf);
+	double BlinnPhongPdf(const Vector3d& normal, const Vector3d& towards_camera, const Vector3d& towards_light, double exponent);
+
+	// Multiple importance sampling weight of the strategy with pdf_a against pdf_b (beta = 2).
+	double PowerHeuristic(double pdf_a, double pdf_b);
 }
 
 #endif
@@ -0,0 +1,776 @@
+// Renders every scene of the scenes folder plus a few generated stress scenes several times,
+// prints the timings and writes them to a JSON report that can be compared against a baseline.
+//
+// With --convergence it instead renders one scene pass after pass and, every interval, measures the error of the
+// running average against a high sample reference image. The error over time shows whether a sampling change
+// actually converges faster, which rays per second alone can't tell.
+//
+// --scaling adds generated scenes of 10, 100, ... up to n spheres to show how the build and trace times grow with the
+// primitive count. --generate writes a generated scene to a file instead of running anything; the generator options
+// also shape the scaling scenes.
+//
+// --thread-scaling renders one scene with 1, 2, 4, ... up to all the threads and reports the speedup, the parallel
+// efficiency and how long every worker sat idle. --pin pins the workers to the CPUs in order, --pin-cpus to the given
+// comma separated CPUs, which decides how they fill the sockets of a NUMA machine.
+//
+// usage: Benchmark [--scenes dir] [--runs n] [--scale s] [--report file] [--baseline file] [--tolerance t] [--timeline file] [--perf] [--save] [--no-stress] [--scaling n]
+//        Benchmark --convergence scene.json [--reference file] [--interval s] [--duration s] [--write-reference] [--scale s] [--report file]
+//        Benchmark --generate scene.json [--seed n] [--spheres n] [--rectangles n] [--point-lights n] [--area-lights n] [--clustering c] [--clusters n] [--materials n] [--instances n]
+//     Benchmark --thread-scaling scene.json [--max-threads n] [--pin] [--pin-cpus list] [--runs n] [--scale s] [--report file]
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+#include "../RayTracer.h"
+#include "../Statistics.h"
+#include "../Parallel.h"
+#include "../Timeline.h"
+#include "../PerfCounters.h"
+#include "../SceneGenerator.h"
+#include "ImageMetrics.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+
+struct BenchmarkSettings
+{
+    std::string scenes_folder = "scenes";
+    unsigned int runs = 3;
+    double scale = 1.0; // Multiplies the resolution of every output
+    std::string report_file = "benchmark_report.json";
+    std::string baseline_file;
+    std::string timeline_file; // Chrome trace-event JSON of the whole benchmark when set
+    double tolerance = 0.1; // Slow down over the baseline that counts as a regression
+    bool save = false;
+    bool stress = true;
+
+    std::string convergence_scene; // Runs the convergence benchmark of this scene file instead when set
+    std::string reference_file; // Defaults to <scene>.reference.ppm next to the scene
+    double interval = 1.0; // Seconds between two error measurements
+    double duration = 30.0; // Seconds of rendering, the reference uses ten times more
+    bool write_reference = false;
+
+    size_t scaling_spheres = 0; // Largest generated scaling scene, none when 0
+    std::string generate_file; // Only writes the generated scene to this file when set
+    SceneGenerator::Settings generator;
+
+    std::string thread_scaling_scene; // Runs the thread scaling benchmark of this scene file instead when set
+    unsigned int max_threads = 0; // Hardware thread count when 0
+    bool pin = false;
+    std::vector<unsigned int> pin_cpus; // Available CPUs in order when pinning without a list
+};
+
+struct BenchmarkScene
+{
+    std::string name;
+    nlohmann::json json;
+};
+
+// Process memory high-water mark in megabytes.
+static double PeakMemoryMB()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0.0;
+
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+
+    return usage.ru_maxrss / 1024.0; // Kilobytes on Linux
+#endif
+}
+
+static double Median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+
+    size_t middle = values.size() / 2;
+    return values.size() % 2 == 1 ? values[middle] : 0.5 * (values[middle - 1] + values[middle]);
+}
+
+static nlohmann::json MaterialJson(const Color& color, float kd, float ks, float pc)
+{
+    return {
+        {"ac", {color.r, color.g, color.b}}, {"dc", {color.r, color.g, color.b}}, {"sc", {1, 1, 1}},
+        {"ka", 0.1}, {"kd", kd}, {"ks", ks}, {"pc", pc}
+    };
+}
+
+static nlohmann::json OutputJson(const std::string& file_name, bool global_illum)
+{
+    nlohmann::json output = {
+        {"filename", file_name}, {"size", {400, 400}}, {"lookat", {0, 0, -1}}, {"up", {0, 1, 0}},
+        {"fov", 45}, {"centre", {0, 0, 12}}, {"ai", {1, 1, 1}}, {"bkc", {0.1, 0.1, 0.1}}
+    };
+
+    if (global_illum)
+    {
+        output["globalillum"] = true;
+        output["raysperpixel"] = {2, 4};
+        output["maxbounces"] = 3;
+        output["probterminate"] = 0.3333;
+    }
+
+    return output;
+}
+
+static nlohmann::json FloorJson(float y)
+{
+    nlohmann::json floor = MaterialJson(Color(0.8f), 0.8f, 0.0f, 1.0f);
+    floor["type"] = "rectangle";
+    floor["p1"] = {-20, y, 20};
+    floor["p2"] = {20, y, 20};
+    floor["p3"] = {20, y, -20};
+    floor["p4"] = {-20, y, -20};
+
+    return floor;
+}
+
+// Scenes far heavier than the bundled ones, they show how the intersection and shading costs grow.
+static std::vector<BenchmarkScene> StressScenes()
+{
+    std::vector<BenchmarkScene> scenes;
+
+    // Many primitives: a 10 x 10 x 10 grid of small spheres.
+    {
+        nlohmann::json scene;
+        scene["geometry"].push_back(FloorJson(-6.0f));
+
+        for (int x = 0; x < 10; x++)
+            for (int y = 0; y < 10; y++)
+                for (int z = 0; z < 10; z++)
+                {
+                    nlohmann::json sphere = MaterialJson(Color(x / 9.0f, y / 9.0f, z / 9.0f), 0.7f, 0.3f, 20.0f);
+                    sphere["type"] = "sphere";
+                    sphere["centre"] = {x - 4.5, y - 4.5, -z - 2.0};
+                    sphere["radius"] = 0.35;
+
+                    scene["geometry"].push_back(sphere);
+                }
+
+        scene["light"].push_back({{"type", "point"}, {"centre", {0, 8, 4}}, {"id", {1, 1, 1}}, {"is", {1, 1, 1}}});
+        scene["output"].push_back(OutputJson("stress_primitives.ppm", false));
+
+        scenes.push_back({"stress_primitives", scene});
+    }
+
+    // Many lights: a few spheres lit by 32 point lights, every light costs a shadow ray per hit.
+    {
+        nlohmann::json scene;
+        scene["geometry"].push_back(FloorJson(-2.0f));
+
+        for (int i = 0; i < 5; i++)
+        {
+            nlohmann::json sphere = MaterialJson(Color(0.9f, 0.6f, 0.3f), 0.8f, 0.2f, 10.0f);
+            sphere["type"] = "sphere";
+            sphere["centre"] = {i * 2.5 - 5.0, -1.0, -4.0};
+            sphere["radius"] = 1.0;
+
+            scene["geometry"].push_back(sphere);
+        }
+
+        for (int i = 0; i < 32; i++)
+        {
+            double angle = i * 2.0 * PI / 32.0;
+            float intensity = 1.0f / 32.0f;
+
+            scene["light"].push_back({{"type", "point"}, {"centre", {8.0 * std::cos(angle), 6.0, 8.0 * std::sin(angle) - 4.0}},
+                                      {"id", {intensity, intensity, intensity}}, {"is", {intensity, intensity, intensity}}});
+        }
+
+        scene["output"].push_back(OutputJson("stress_lights.ppm", false));
+
+        scenes.push_back({"stress_lights", scene});
+    }
+
+    // Deep paths: global illumination in a closed box.
+    {
+        nlohmann::json scene;
+
+        const double s = 5.0;
+        const double corners[5][4][3] = {
+            {{-s, -s, -s}, {s, -s, -s}, {s, s, -s}, {-s, s, -s}}, // back
+            {{-s, -s, s}, {s, -s, s}, {s, -s, -s}, {-s, -s, -s}}, // floor
+            {{-s, s, -s}, {s, s, -s}, {s, s, s}, {-s, s, s}}, // ceiling
+            {{-s, -s, s}, {-s, -s, -s}, {-s, s, -s}, {-s, s, s}}, // left
+            {{s, -s, -s}, {s, -s, s}, {s, s, s}, {s, s, -s}}, // right
+        };
+        const Color colors[5] = { Color(0.8f), Color(0.8f), Color(0.8f), Color(0.8f, 0.1f, 0.1f), Color(0.1f, 0.8f, 0.1f) };
+
+        for (int wall = 0; wall < 5; wall++)
+        {
+            nlohmann::json rectangle = MaterialJson(colors[wall], 0.8f, 0.0f, 1.0f);
+            rectangle["type"] = "rectangle";
+
+            for (int i = 0; i < 4; i++)
+            {
+                rectangle["p" + std::to_string(i + 1)] = {corners[wall][i][0], corners[wall][i][1], corners[wall][i][2]};
+            }
+
+            scene["geometry"].push_back(rectangle);
+        }
+
+        nlohmann::json sphere = MaterialJson(Color(0.9f), 0.8f, 0.0f, 1.0f);
+        sphere["type"] = "sphere";
+        sphere["centre"] = {0, -3, -1};
+        sphere["radius"] = 2.0;
+        scene["geometry"].push_back(sphere);
+
+        scene["light"].push_back({{"type", "point"}, {"centre", {0, 4.5, -1}}, {"id", {1, 1, 1}}, {"is", {1, 1, 1}}});
+        scene["output"].push_back(OutputJson("stress_gi.ppm", true));
+
+        scenes.push_back({"stress_gi", scene});
+    }
+
+    return scenes;
+}
+
+static std::vector<BenchmarkScene> LoadScenes(const BenchmarkSettings& settings)
+{
+    std::vector<BenchmarkScene> scenes;
+
+    std::vector<std::filesystem::path> files;
+
+    if (std::filesystem::is_directory(settings.scenes_folder))
+    {
+        for (auto& entry : std::filesystem::directory_iterator(settings.scenes_folder))
+        {
+            if (entry.path().extension() == ".json") files.push_back(entry.path());
+        }
+    }
+    else
+    {
+        PRINT("Scene folder " << settings.scenes_folder << " does not exist!");
+    }
+
+    std::sort(files.begin(), files.end());
+
+    for (auto& file : files)
+    {
+        std::ifstream t(file);
+        std::stringstream buffer;
+        buffer << t.rdbuf();
+
+        scenes.push_back({file.stem().string(), nlohmann::json::parse(buffer.str())});
+    }
+
+    if (settings.stress)
+    {
+        for (BenchmarkScene& scene : StressScenes()) scenes.push_back(scene);
+    }
+
+    for (size_t spheres = 10; spheres <= settings.scaling_spheres; spheres *= 10)
+    {
+        SceneGenerator::Settings generator = settings.generator;
+        generator.spheres = spheres;
+        generator.file_name = "scaling_" + std::to_string(spheres) + ".ppm";
+
+        scenes.push_back({"scaling_" + std::to_string(spheres), SceneGenerator::Generate(generator)});
+    }
+
+    return scenes;
+}
+
+static nlohmann::json ScaleOutputs(nlohmann::json json, double scale)
+{
+    for (auto& output : json.at("output"))
+    {
+        output["size"][0] = std::max(1, (int)((double)output["size"][0] * scale));
+        output["size"][1] = std::max(1, (int)((double)output["size"][1] * scale));
+    }
+
+    return json;
+}
+
+// Returns false when the scene can't be built.
+static bool RunScene(const BenchmarkScene& scene, const BenchmarkSettings& settings, nlohmann::json& out_report)
+{
+    nlohmann::json json = ScaleOutputs(scene.json, settings.scale);
+
+    std::vector<double> walls, builds, setups, traces, denoises, saves;
+    Statistics::Report statistics;
+
+    for (unsigned int run = 0; run < settings.runs; run++)
+    {
+        TIMELINE_SCOPE("BenchmarkRun", run);
+
+        auto start = std::chrono::steady_clock::now();
+
+        RayTracer tracer(json);
+        tracer.SetSaveOutputs(settings.save);
+        if (!tracer.run()) return false;
+
+        walls.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        const PhaseTimes& times = tracer.GetPhaseTimes();
+        builds.push_back(times.build);
+        setups.push_back(times.setup);
+        traces.push_back(times.trace);
+        denoises.push_back(times.denoise);
+        saves.push_back(times.save);
+
+        statistics = tracer.GetStatistics(); // Every run casts about the same rays, the last one is kept
+    }
+
+    double trace = std::max(Median(traces), 1e-9);
+
+    nlohmann::json report;
+    report["wall_median"] = Median(walls);
+    report["wall_min"] = *std::min_element(walls.begin(), walls.end());
+    report["wall_max"] = *std::max_element(walls.begin(), walls.end());
+    report["phases"] = {
+        {"build", Median(builds)}, {"setup", Median(setups)}, {"trace", Median(traces)},
+        {"denoise", Median(denoises)}, {"save", Median(saves)}
+    };
+    const uint64_t primary = statistics.counters[Statistics::PrimaryRays];
+    const uint64_t shadow = statistics.counters[Statistics::ShadowRays];
+    const uint64_t indirect = statistics.counters[Statistics::IndirectRays];
+
+    report["rays"] = { {"primary", primary}, {"shadow", shadow}, {"indirect", indirect} };
+    report["rays_per_second"] = {
+        {"primary", primary / trace}, {"shadow", shadow / trace},
+        {"indirect", indirect / trace}, {"total", statistics.Rays() / trace}
+    };
+    report["statistics"] = nlohmann::json::parse(statistics.ToJSON());
+    report["peak_memory_mb"] = PeakMemoryMB();
+
+    out_report = report;
+    return true;
+}
+
+static std::string ReferenceFile(const BenchmarkSettings& settings)
+{
+    if (!settings.reference_file.empty()) return settings.reference_file;
+
+    std::filesystem::path scene_file(settings.convergence_scene);
+    return (scene_file.parent_path() / (scene_file.stem().string() + ".reference.ppm")).string();
+}
+
+// Renders the first output of the scene pass after pass for the duration, every pass with the samples of the scene file.
+// on_pass gets the running average and the seconds spent rendering so far, the scene build excluded.
+template <typename OnPass>
+static bool RenderProgressively(const nlohmann::json& json, double duration, OnPass on_pass)
+{
+    RayTracer tracer(json);
+    tracer.SetSaveOutputs(false);
+
+    std::vector<Color> pass;
+    std::vector<Color> sum;
+    std::vector<Color> average;
+    unsigned int passes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+
+    while (elapsed < duration)
+    {
+        TIMELINE_SCOPE("ConvergencePass", passes);
+
+        if (!tracer.RenderOutput(0, pass)) return false;
+
+        if (sum.empty()) sum.assign(pass.size(), Color::Black());
+        for (size_t i = 0; i < pass.size(); i++) sum[i] += pass[i];
+        passes++;
+
+        average.resize(sum.size());
+        for (size_t i = 0; i < sum.size(); i++) average[i] = sum[i] * (1.0 / passes);
+
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - tracer.GetPhaseTimes().build;
+
+        on_pass(average, passes, elapsed);
+    }
+
+    return true;
+}
+
+// Returns non zero when the reference can't be made or read.
+static int RunConvergence(const BenchmarkSettings& settings)
+{
+    std::ifstream t(settings.convergence_scene);
+    if (!t)
+    {
+        PRINT("Scene " << settings.convergence_scene << " does not exist!");
+        return -1;
+    }
+
+    nlohmann::json json = ScaleOutputs(nlohmann::json::parse(t), settings.scale);
+    const unsigned int width = json.at("output")[0]["size"][0];
+    const unsigned int height = json.at("output")[0]["size"][1];
+    const std::string reference_file = ReferenceFile(settings);
+
+    if (settings.write_reference)
+    {
+        ImageMetrics::Image reference{ width, height, {} };
+        unsigned int reference_passes = 0;
+
+        PRINT("Rendering the reference for " << settings.duration * 10.0 << "s...");
+
+        bool rendered = RenderProgressively(json, settings.duration * 10.0, [&](const std::vector<Color>& average, unsigned int passes, double)
+        {
+            reference.pixels = average;
+            reference_passes = passes;
+        });
+
+        if (!rendered || !ImageMetrics::WritePPM(reference_file, reference))
+        {
+            PRINT("Could not write the reference " << reference_file << "!");
+            return -1;
+        }
+
+        PRINT("Reference of " << reference_passes << " passes saved as " << reference_file << ".");
+        return 0;
+    }
+
+    ImageMetrics::Image reference;
+    if (!ImageMetrics::ReadPPM(reference_file, reference))
+    {
+        PRINT("Reference " << reference_file << " does not exist or is not a P6 .ppm, make it with --write-reference.");
+        return -1;
+    }
+
+    if (reference.width != width || reference.height != height)
+    {
+        PRINT("Reference is " << reference.width << "x" << reference.height << " but the output is " << width << "x" << height << ", check --scale.");
+        return -1;
+    }
+
+    nlohmann::json curve = nlohmann::json::array();
+    double next_measure = settings.interval;
+
+    PRINT("==== " << settings.convergence_scene << " against " << reference_file << " ====");
+    std::cout << std::setw(10) << "time" << std::setw(10) << "passes" << std::setw(12) << "rmse" << std::setw(10) << "psnr" << std::setw(10) << "ssim" << std::endl;
+
+    bool rendered = RenderProgressively(json, settings.duration, [&](const std::vector<Color>& average, unsigned int passes, double elapsed)
+    {
+        // A slow pass can skip several intervals, the error is only measured once for them.
+        if (elapsed < next_measure && elapsed < settings.duration) return;
+        while (next_measure <= elapsed) next_measure += settings.interval;
+
+        double rmse = ImageMetrics::RMSE(average, reference.pixels);
+        double psnr = ImageMetrics::PSNR(rmse);
+        double ssim = ImageMetrics::SSIM(average, reference.pixels, width, height);
+
+        curve.push_back({ {"time", elapsed}, {"passes", passes}, {"rmse", rmse}, {"psnr", psnr}, {"ssim", ssim} });
+
+        std::cout << std::fixed << std::setprecision(2) << std::setw(10) << elapsed << std::setw(10) << passes
+                  << std::setprecision(5) << std::setw(12) << rmse << std::setprecision(2) << std::setw(10) << psnr
+                  << std::setprecision(4) << std::setw(10) << ssim << std::endl;
+    });
+
+    if (!rendered) return -1;
+
+    nlohmann::json report;
+    report["scene"] = settings.convergence_scene;
+    report["reference"] = reference_file;
+    report["scale"] = settings.scale;
+    report["interval"] = settings.interval;
+    report["threads"] = Parallel::ThreadCount();
+    report["convergence"] = curve;
+
+    std::ofstream ofs(settings.report_file);
+    ofs << report.dump(4) << std::endl;
+
+    PRINT("Report saved as " << settings.report_file << ".");
+
+    return 0;
+}
+
+static int RunThreadScaling(const BenchmarkSettings& settings)
+{
+    std::ifstream t(settings.thread_scaling_scene);
+    if (!t)
+    {
+        PRINT("Scene " << settings.thread_scaling_scene << " does not exist!");
+        return -1;
+    }
+
+    nlohmann::json json = ScaleOutputs(nlohmann::json::parse(t), settings.scale);
+
+    std::vector<unsigned int> cpus = settings.pin_cpus;
+    if (settings.pin && cpus.empty()) cpus = Parallel::AvailableCpus();
+    Parallel::SetPinning(cpus);
+
+    const unsigned int max_threads = settings.max_threads != 0 ? settings.max_threads : Parallel::ThreadCount();
+
+    std::vector<unsigned int> thread_counts;
+    for (unsigned int threads = 1; threads < max_threads; threads *= 2) thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+
+    nlohmann::json steps = nlohmann::json::array();
+    double single_thread_trace = 0.0;
+    double single_thread_wall = 0.0;
+
+    PRINT("==== " << settings.thread_scaling_scene << (cpus.empty() ? "" : ", pinned") << " ====");
+    std::cout << std::setw(8) << "threads" << std::setw(10) << "wall" << std::setw(10) << "trace" << std::setw(10) << "speedup"
+              << std::setw(12) << "efficiency" << std::setw(12) << "idle mean" << std::setw(10) << "idle max" << std::endl;
+
+    for (unsigned int threads : thread_counts)
+    {
+        Parallel::SetThreadCount(threads);
+
+        std::vector<double> walls, traces, idle_means, idle_maxes;
+        std::vector<double> idle(threads, 0.0); // Of the median run
+
+        for (unsigned int run = 0; run < settings.runs; run++)
+        {
+            TIMELINE_SCOPE("ThreadScalingRun", threads);
+
+            RayTracer tracer(json);
+            tracer.SetSaveOutputs(false);
+
+            Parallel::ResetUsage();
+            auto start = std::chrono::steady_clock::now();
+
+            if (!tracer.run())
+            {
+                PRINT("Scene " << settings.thread_scaling_scene << " could not be built!");
+                return -1;
+            }
+
+            walls.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            traces.push_back(tracer.GetPhaseTimes().trace);
+
+            // Shares of the time spent in the parallel loops, so they compare between thread counts.
+            Parallel::Usage usage = Parallel::GetUsage();
+            double mean = 0.0, max = 0.0;
+
+            for (unsigned int worker = 0; worker < threads; worker++)
+            {
+                double share = usage.wall > 0.0 ? usage.Idle(worker) / usage.wall : 0.0;
+                mean += share / threads;
+                max = std::max(max, share);
+                if (run == settings.runs / 2) idle[worker] = usage.Idle(worker);
+            }
+
+            idle_means.push_back(mean);
+            idle_maxes.push_back(max);
+        }
+
+        double wall = Median(walls);
+        double trace = std::max(Median(traces), 1e-9);
+
+        if (threads == 1)
+        {
+            single_thread_trace = trace;
+            single_thread_wall = wall;
+        }
+
+        double speedup = single_thread_trace / trace;
+        double efficiency = speedup / threads;
+
+        steps.push_back({
+            {"threads", threads}, {"wall_median", wall}, {"trace_median", trace},
+            {"speedup", speedup}, {"wall_speedup", single_thread_wall / wall}, {"efficiency", efficiency},
+            {"idle_share_mean", Median(idle_means)}, {"idle_share_max", Median(idle_maxes)}, {"idle_seconds", idle}
+        });
+
+        std::cout << std::fixed << std::setprecision(3) << std::setw(8) << threads << std::setw(10) << wall << std::setw(10) << trace
+                  << std::setprecision(2) << std::setw(10) << speedup << std::setw(11) << efficiency * 100.0 << "%"
+                  << std::setw(11) << Median(idle_means) * 100.0 << "%" << std::setw(9) << Median(idle_maxes) * 100.0 << "%" << std::endl;
+    }
+
+    Parallel::SetThreadCount(0);
+    Parallel::SetPinning({});
+
+    nlohmann::json report;
+    report["scene"] = settings.thread_scaling_scene;
+    report["runs"] = settings.runs;
+    report["scale"] = settings.scale;
+    report["hardware_threads"] = std::thread::hardware_concurrency();
+    report["pinned_cpus"] = cpus;
+    report["thread_scaling"] = steps;
+
+    std::ofstream ofs(settings.report_file);
+    ofs << report.dump(4) << std::endl;
+
+    PRINT("Report saved as " << settings.report_file << ".");
+
+    return 0;
+}
+
+// Returns the number of scenes slower than the baseline by more than the tolerance.
+static unsigned int CompareWithBaseline(const nlohmann::json& report, const BenchmarkSettings& settings)
+{
+    std::ifstream t(settings.baseline_file);
+    if (!t)
+    {
+        PRINT("Baseline " << settings.baseline_file << " does not exist!");
+        return 0;
+    }
+
+    nlohmann::json baseline = nlohmann::json::parse(t);
+
+    unsigned int regressions = 0;
+
+    PRINT("==== Baseline " << settings.baseline_file << " ====");
+
+    for (auto& item : report.at("scenes").items())
+    {
+        if (!baseline["scenes"].contains(item.key()))
+        {
+            PRINT(item.key() << ": not in the baseline");
+            continue;
+        }
+
+        double current = item.value().at("wall_median");
+        double previous = baseline["scenes"][item.key()].at("wall_median");
+        double change = previous > 0.0 ? current / previous - 1.0 : 0.0;
+
+        bool regressed = change > settings.tolerance;
+        if (regressed) regressions++;
+
+        PRINT(item.key() << ": " << previous << "s -> " << current << "s (" << (change >= 0.0 ? "+" : "") << change * 100.0 << "%)"
+              << (regressed ? "  REGRESSION" : ""));
+    }
+
+    return regressions;
+}
+
+static bool ReadArguments(int argc, char** argv, BenchmarkSettings& settings)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (argument == "--scenes" && has_value) settings.scenes_folder = argv[++i];
+        else if (argument == "--runs" && has_value) settings.runs = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--scale" && has_value) settings.scale = std::atof(argv[++i]);
+        else if (argument == "--report" && has_value) settings.report_file = argv[++i];
+        else if (argument == "--baseline" && has_value) settings.baseline_file = argv[++i];
+        else if (argument == "--tolerance" && has_value) settings.tolerance = std::atof(argv[++i]);
+        else if (argument == "--timeline" && has_value) settings.timeline_file = argv[++i];
+        else if (argument == "--perf") PerfCounters::Enable(true);
+        else if (argument == "--save") settings.save = true;
+        else if (argument == "--no-stress") settings.stress = false;
+        else if (argument == "--convergence" && has_value) settings.convergence_scene = argv[++i];
+        else if (argument == "--reference" && has_value) settings.reference_file = argv[++i];
+        else if (argument == "--interval" && has_value) settings.interval = std::max(0.01, std::atof(argv[++i]));
+        else if (argument == "--duration" && has_value) settings.duration = std::max(0.01, std::atof(argv[++i]));
+        else if (argument == "--write-reference") settings.write_reference = true;
+        else if (argument == "--scaling" && has_value) settings.scaling_spheres = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--generate" && has_value) settings.generate_file = argv[++i];
+        else if (argument == "--seed" && has_value) settings.generator.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--spheres" && has_value) settings.generator.spheres = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--rectangles" && has_value) settings.generator.rectangles = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--point-lights" && has_value) settings.generator.point_lights = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--area-lights" && has_value) settings.generator.area_lights = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--clustering" && has_value) settings.generator.clustering = std::atof(argv[++i]);
+        else if (argument == "--thread-scaling" && has_value) settings.thread_scaling_scene = argv[++i];
+        else if (argument == "--max-threads" && has_value) settings.max_threads = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--pin") settings.pin = true;
+        else if (argument == "--pin-cpus" && has_value)
+        {
+            std::stringstream list(argv[++i]);
+            std::string cpu;
+            while (std::getline(list, cpu, ',')) settings.pin_cpus.push_back((unsigned int)std::atoi(cpu.c_str()));
+            settings.pin = true;
+        }
+        else if (argument == "--clusters" && has_value) settings.generator.clusters = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--materials" && has_value) settings.generator.materials = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--instances" && has_value) settings.generator.instances = std::strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            PRINT("Unknown argument " << argument);
+            PRINT("usage: Benchmark [--scenes dir] [--runs n] [--scale s] [--report file] [--baseline file] [--tolerance t] [--timeline file] [--perf] [--save] [--no-stress] [--scaling n]");
+            PRINT("       Benchmark --convergence scene.json [--reference file] [--interval s] [--duration s] [--write-reference] [--scale s] [--report file]");
+            PRINT("       Benchmark --generate scene.json [--seed n] [--spheres n] [--rectangles n] [--point-lights n] [--area-lights n] [--clustering c] [--clusters n] [--materials n] [--instances n]");
+            PRINT("       Benchmark --thread-scaling scene.json [--max-threads n] [--pin] [--pin-cpus list] [--runs n] [--scale s] [--report file]");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkSettings settings;
+    if (!ReadArguments(argc, argv, settings)) return -1;
+
+#if !RAYTRACER_STATS
+    PRINT("Built without RAYTRACER_STATS, the ray counts will be zero.");
+#endif
+
+    if (!settings.generate_file.empty())
+    {
+        if (!SceneGenerator::Write(settings.generator, settings.generate_file))
+        {
+            PRINT("Could not write " << settings.generate_file << "!");
+            return -1;
+        }
+
+        PRINT("Scene saved as " << settings.generate_file << ".");
+        return 0;
+    }
+
+    if (!settings.timeline_file.empty()) Timeline::Enable(true);
+
+    if (!settings.convergence_scene.empty() || !settings.thread_scaling_scene.empty())
+    {
+        int result = !settings.convergence_scene.empty() ? RunConvergence(settings) : RunThreadScaling(settings);
+
+        if (!settings.timeline_file.empty() && Timeline::Save(settings.timeline_file)) PRINT("Timeline saved as " << settings.timeline_file << ".");
+
+        return result;
+    }
+
+    nlohmann::json report;
+    report["runs"] = settings.runs;
+    report["scale"] = settings.scale;
+    report["threads"] = Parallel::ThreadCount();
+    report["scenes"] = nlohmann::json::object();
+
+    for (BenchmarkScene& scene : LoadScenes(settings))
+    {
+        PRINT("==== " << scene.name << " ====");
+
+        if (!RunScene(scene, settings, report["scenes"][scene.name]))
+        {
+            PRINT("Scene " << scene.name << " could not be built!");
+            return -1;
+        }
+    }
+
+    report["peak_memory_mb"] = PeakMemoryMB();
+
+    PRINT("==== Results ====");
+
+    for (auto& item : report["scenes"].items())
+    {
+        auto& result = item.value();
+
+        PRINT(item.key() << ": " << (double)result["wall_median"] << "s wall, "
+              << (double)result["phases"]["trace"] << "s trace, "
+              << (double)result["rays_per_second"]["total"] / 1e6 << " Mrays/s, "
+              << (double)result["peak_memory_mb"] << " MB peak");
+    }
+
+    std::ofstream ofs(settings.report_file);
+    ofs << report.dump(4) << std::endl;
+
+    PRINT("Report saved as " << settings.report_file << ".");
+
+    if (!settings.timeline_file.empty() && Timeline::Save(settings.timeline_file)) PRINT("Timeline saved as " << settings.timeline_file << ".");
+
+    if (!settings.baseline_file.empty() && CompareWithBaseline(report, settings) > 0) return 1;
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include "ImageMetrics.h"
+
+#include <fstream>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cctype>
+
+namespace ImageMetrics
+{
+    static const unsigned int SSIM_WINDOW = 8;
+    static const unsigned int SSIM_STRIDE = 4;
+    static const double SSIM_C1 = 0.01 * 0.01; // (k1 * L)^2 with L = 1
+    static const double SSIM_C2 = 0.03 * 0.03; // (k2 * L)^2
+
+    static double Luminance(const Color& color)
+    {
+        Color c = color.Clamp();
+        return 0.2126 * c.r + 0.7152 * c.g + 0.0722 * c.b;
+    }
+
+    // Skips white space and # comments between the header fields.
+    static void SkipHeaderSpace(std::ifstream& ifs)
+    {
+        while (ifs)
+        {
+            int c = ifs.peek();
+
+            if (c == '#') ifs.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            else if (std::isspace(c)) ifs.get();
+            else break;
+        }
+    }
+
+    bool ReadPPM(const std::string& file_name, Image& out_image)
+    {
+        std::ifstream ifs(file_name, std::ios_base::in | std::ios_base::binary);
+        if (!ifs) return false;
+
+        std::string magic;
+        unsigned int max_value = 0;
+
+        ifs >> magic;
+        if (magic != "P6") return false;
+
+        SkipHeaderSpace(ifs);
+        ifs >> out_image.width;
+        SkipHeaderSpace(ifs);
+        ifs >> out_image.height;
+        SkipHeaderSpace(ifs);
+        ifs >> max_value;
+        ifs.get(); // Single white space before the pixels
+
+        if (!ifs || max_value != 255 || out_image.width == 0 || out_image.height == 0) return false;
+
+        size_t size = (size_t)out_image.width * out_image.height;
+        std::vector<unsigned char> bytes(size * 3);
+
+        if (!ifs.read((char*)bytes.data(), bytes.size())) return false;
+
+        out_image.pixels.resize(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            out_image.pixels[i] = Color(bytes[i * 3] / 255.0f, bytes[i * 3 + 1] / 255.0f, bytes[i * 3 + 2] / 255.0f);
+        }
+
+        return true;
+    }
+
+    bool WritePPM(const std::string& file_name, const Image& image)
+    {
+        std::ofstream ofs(file_name, std::ios_base::out | std::ios_base::binary);
+        if (!ofs) return false;
+
+        ofs << "P6" << std::endl << image.width << ' ' << image.height << std::endl << "255" << std::endl;
+
+        for (const Color& pixel : image.pixels)
+        {
+            Color color = pixel.Clamp();
+            ofs << (unsigned char)(255.0f * color.r) << (unsigned char)(255.0f * color.g) << (unsigned char)(255.0f * color.b);
+        }
+
+        return (bool)ofs;
+    }
+
+    double RMSE(const std::vector<Color>& image, const std::vector<Color>& reference)
+    {
+        size_t size = std::min(image.size(), reference.size());
+        if (size == 0) return 0.0;
+
+        double sum = 0.0;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            Color a = image[i].Clamp();
+            Color b = reference[i].Clamp();
+
+            double dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+            sum += dr * dr + dg * dg + db * db;
+        }
+
+        return std::sqrt(sum / (3.0 * size));
+    }
+
+    double PSNR(double rmse)
+    {
+        if (rmse <= 0.0) return std::numeric_limits<double>::infinity();
+
+        return 20.0 * std::log10(1.0 / rmse);
+    }
+
+    double SSIM(const std::vector<Color>& image, const std::vector<Color>& reference, unsigned int width, unsigned int height)
+    {
+        if (image.size() < (size_t)width * height || reference.size() < (size_t)width * height) return 0.0;
+
+        std::vector<double> x(image.size()), y(reference.size());
+        for (size_t i = 0; i < (size_t)width * height; i++)
+        {
+            x[i] = Luminance(image[i]);
+            y[i] = Luminance(reference[i]);
+        }
+
+        // Images smaller than a window are treated as a single window.
+        unsigned int window_w = std::min(SSIM_WINDOW, width);
+        unsigned int window_h = std::min(SSIM_WINDOW, height);
+        double n = (double)window_w * window_h;
+
+        double total = 0.0;
+        unsigned int windows = 0;
+
+        for (unsigned int wy = 0; wy + window_h <= height; wy += SSIM_STRIDE)
+        {
+            for (unsigned int wx = 0; wx + window_w <= width; wx += SSIM_STRIDE)
+            {
+                double sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_yy = 0.0, sum_xy = 0.0;
+
+                for (unsigned int j = wy; j < wy + window_h; j++)
+                {
+                    for (unsigned int i = wx; i < wx + window_w; i++)
+                    {
+                        size_t index = (size_t)j * width + i;
+                        sum_x += x[index];
+                        sum_y += y[index];
+                        sum_xx += x[index] * x[index];
+                        sum_yy += y[index] * y[index];
+                        sum_xy += x[index] * y[index];
+                    }
+                }
+
+                double mean_x = sum_x / n, mean_y = sum_y / n;
+                double var_x = std::max(0.0, sum_xx / n - mean_x * mean_x);
+                double var_y = std::max(0.0, sum_yy / n - mean_y * mean_y);
+                double covariance = sum_xy / n - mean_x * mean_y;
+
+                total += ((2.0 * mean_x * mean_y + SSIM_C1) * (2.0 * covariance + SSIM_C2))
+                       / ((mean_x * mean_x + mean_y * mean_y + SSIM_C1) * (var_x + var_y + SSIM_C2));
+                windows++;
+            }
+        }
+
+        return windows > 0 ? total / windows : 0.0;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef IMAGE_METRICS_H
+#define IMAGE_METRICS_H
+
+#include <string>
+#include <vector>
+
+#include "../Color.h"
+
+// Error of a rendered image against a reference, on colours clamped to [0, 1] like the saved .ppm.
+namespace ImageMetrics
+{
+    struct Image
+    {
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::vector<Color> pixels;
+    };
+
+    // Binary (P6) .ppm with 255 as maximum value, which is what the tracer writes. False when the file can't be read.
+    bool ReadPPM(const std::string& file_name, Image& out_image);
+    bool WritePPM(const std::string& file_name, const Image& image);
+
+    // Root mean square error over the three channels.
+    double RMSE(const std::vector<Color>& image, const std::vector<Color>& reference);
+    // Peak signal to noise ratio in decibels, infinite for identical images.
+    double PSNR(double rmse);
+    // Mean structural similarity of the luminance over 8x8 windows, 1 for identical images.
+    double SSIM(const std::vector<Color>& image, const std::vector<Color>& reference, unsigned int width, unsigned int height);
+}
+
+#endif // !IMAGE_METRICS_H
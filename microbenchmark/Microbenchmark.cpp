@@ -0,0 +1,192 @@
+// Times the hot kernels of the tracer on their own, each one over random inputs in two working sets:
+// a small one read in order that stays in the L1 cache and a large one read in shuffled order that misses it.
+//
+// usage: Microbenchmark [--elements n] [--filter kernel]
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+
+#include "../RayTracer.h"
+#include "../CycleCounter.h"
+
+static const size_t HOT_ELEMENTS = 256;
+static const size_t MIN_OPS = 1 << 22; // Every trial runs at least this many kernel calls
+static const unsigned int TRIALS = 5; // The fastest trial is kept
+
+static volatile double sink; // Keeps the compiler from dropping the kernel results
+
+class Microbenchmark
+{
+public:
+    Microbenchmark(size_t elements, bool shuffled, const std::string& filter)
+        : tracer(nlohmann::json::object()), filter(filter)
+    {
+        std::mt19937 generator(1234);
+        std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+        auto random_vector = [&]() { return Vector3d(uniform(generator), uniform(generator), uniform(generator)); };
+        auto random_unit = [&]() { Vector3d v = random_vector(); return v.norm() > 1e-6 ? v.normalized() : Vector3d(0, 0, 1); };
+
+        for (size_t i = 0; i < elements; i++)
+        {
+            // Rays start around the origin and aim roughly at the primitives so about half of them hit.
+            Vector3d origin = random_vector();
+            Vector3d center = Vector3d(0, 0, -5) + random_vector();
+            double radius = 0.5 + 0.5 * std::abs(uniform(generator));
+
+            rays.push_back(Ray(origin, (center + random_vector() - origin).normalized()));
+            spheres.push_back(Sphere(0, center, radius));
+
+            Vector3d p1 = center + Vector3d(-1, -1, 0), p2 = center + Vector3d(1, -1, 0), p3 = center + Vector3d(1, 1, 0), p4 = center + Vector3d(-1, 1, 0);
+            rectangles.push_back(Rectangle(p1, p2, p3, p4));
+
+            normals.push_back(random_unit());
+            towards_lights.push_back(random_unit());
+            towards_cameras.push_back(random_unit());
+
+            a.push_back(1.0);
+            b.push_back(4.0 * uniform(generator));
+            c.push_back(2.0 * uniform(generator));
+
+            colors.push_back(Color((float)std::abs(uniform(generator)), (float)std::abs(uniform(generator)), (float)std::abs(uniform(generator))));
+        }
+
+        order.resize(elements);
+        for (size_t i = 0; i < elements; i++) order[i] = (uint32_t)i;
+        if (shuffled) std::shuffle(order.begin(), order.end(), generator);
+
+        working_set = std::to_string(elements) + (shuffled ? " shuffled" : " in order");
+    }
+
+    void Run()
+    {
+        Measure("IntersectCoor sphere", [&](uint32_t i)
+        {
+            Vector3d intersect;
+            return tracer.IntersectCoor(rays[i], spheres[i], intersect) ? intersect.z() : 0.0;
+        });
+
+        Measure("IntersectCoor rectangle", [&](uint32_t i)
+        {
+            Vector3d intersect;
+            return tracer.IntersectCoor(rays[i], rectangles[i], intersect) ? intersect.z() : 0.0;
+        });
+
+        Measure("BlinnPhong", [&](uint32_t i)
+        {
+            return tracer.BlinnPhong(normals[i], towards_lights[i], towards_cameras[i]);
+        });
+
+        Measure("YuMath::RandomDir", [&](uint32_t i)
+        {
+            return YuMath::RandomDir(normals[i]).x();
+        });
+
+        Measure("YuMath::Quadratic", [&](uint32_t i)
+        {
+            auto t = YuMath::Quadratic(a[i], b[i], c[i]);
+            return t != nullptr ? t->b_neg : 0.0;
+        });
+
+        Measure("Color multiply add", [&](uint32_t i)
+        {
+            Color color = colors[i] * colors[order[i]] + colors[i] * 0.5;
+            return (double)color.r;
+        });
+
+        Measure("Color::MulAdd", [&](uint32_t i)
+        {
+            Color color = Color::MulAdd(colors[i], colors[order[i]], colors[i] * 0.5);
+            return (double)color.r;
+        });
+    }
+
+private:
+    template <typename Kernel>
+    void Measure(const std::string& name, Kernel kernel)
+    {
+        if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+        const size_t passes = std::max<size_t>(1, MIN_OPS / order.size());
+        const double ops = (double)passes * order.size();
+
+        double best_ns = DBL_MAX;
+        double best_cycles = DBL_MAX;
+        double total = 0.0;
+
+        for (uint32_t i : order) total += kernel(i); // Warm up, pulls the small working set in the cache
+
+        for (unsigned int trial = 0; trial < TRIALS; trial++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            uint64_t start_cycles = CycleCounter::Read();
+
+            for (size_t pass = 0; pass < passes; pass++)
+            {
+                for (uint32_t i : order) total += kernel(i);
+            }
+
+            uint64_t cycles = CycleCounter::Read() - start_cycles;
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            best_ns = std::min(best_ns, ns);
+            best_cycles = std::min(best_cycles, (double)cycles);
+        }
+
+        sink = total;
+
+        std::cout << std::left << std::setw(26) << name << std::setw(20) << working_set
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << best_ns / ops
+                  << std::setw(14) << std::setprecision(4) << ops / best_cycles << std::endl;
+    }
+
+    RayTracer tracer;
+    std::string filter;
+    std::string working_set;
+
+    std::vector<Ray> rays;
+    std::vector<Sphere> spheres;
+    std::vector<Rectangle> rectangles;
+    std::vector<Vector3d> normals, towards_lights, towards_cameras;
+    std::vector<double> a, b, c;
+    std::vector<Color> colors;
+    std::vector<uint32_t> order;
+};
+
+int main(int argc, char** argv)
+{
+    size_t cold_elements = 1 << 17;
+    std::string filter;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+
+        if (argument == "--elements" && i + 1 < argc) cold_elements = std::max(HOT_ELEMENTS, (size_t)std::atoll(argv[++i]));
+        else if (argument == "--filter" && i + 1 < argc) filter = argv[++i];
+        else
+        {
+            PRINT("usage: Microbenchmark [--elements n] [--filter kernel]");
+            return -1;
+        }
+    }
+
+    if (!CycleCounter::Available()) PRINT("No time stamp counter, ops/cycle is ops per nanosecond.");
+
+    Microbenchmark hot(HOT_ELEMENTS, false, filter);
+    Microbenchmark cold(cold_elements, true, filter);
+
+    std::cout << std::left << std::setw(26) << "kernel" << std::setw(20) << "working set"
+              << std::right << std::setw(12) << "ns/op" << std::setw(14) << "ops/cycle" << std::endl;
+
+    hot.Run();
+    cold.Run();
+
+    return 0;
+}